@@ -0,0 +1,63 @@
+# Writes a C++ source with SITES distinct encrypted literal sites, one
+# function per site, and a main() that calls one of them chosen at runtime.
+# MODE selects how each site uses its literal:
+#
+#    str      ENC_STR (default)
+#    buf      ENC_BUF(...).get()
+#    lit      ENC_LIT(...).decrypt() into a stack buffer, wiped after use
+#    chunks   ENC_LIT(...).write_chunks()
+#
+# Usage: cmake -DSITES=1000 [-DMODE=str] -DOUT=sites.cpp -P generate_sites.cmake
+
+cmake_minimum_required(VERSION 3.14)
+
+if(NOT DEFINED SITES OR NOT DEFINED OUT)
+    message(FATAL_ERROR "usage: cmake -DSITES=<n> [-DMODE=<mode>] -DOUT=<file> -P generate_sites.cmake")
+endif()
+if(NOT DEFINED MODE)
+    set(MODE str)
+endif()
+
+set(texts
+    "key.@i@"
+    "handler @i@: request accepted"
+    "X-Service-Route-@i@: /api/v2/tenants/{tenant}/resources/{id}"
+    "site @i@ failed to validate the session token against the configured issuer")
+
+if(MODE STREQUAL "str")
+    set(body "sink(ENC_STR(\"@text@\"));")
+elseif(MODE STREQUAL "buf")
+    set(body "sink(ENC_BUF(\"@text@\").get(0));")
+elseif(MODE STREQUAL "lit")
+    set(body "char b[sizeof(\"@text@\")]; ENC_LIT(\"@text@\").decrypt(b); sink(b); secure_wipe(b, sizeof(b));")
+elseif(MODE STREQUAL "chunks")
+    set(body "ENC_LIT(\"@text@\").write_chunks([](const char* p, secure_u64) { sink(p); return true; });")
+else()
+    message(FATAL_ERROR "generate_sites.cmake: unknown MODE ${MODE}")
+endif()
+
+set(src "// Generated by generate_sites.cmake (MODE=${MODE}), do not edit.\n#include \"secure_string.hpp\"\n\n")
+string(APPEND src "static volatile char sink_byte;\nstatic void sink(const char* p) { sink_byte = p[0]; }\n\n")
+math(EXPR last "${SITES} - 1")
+foreach(i RANGE ${last})
+    math(EXPR k "${i} % 4")
+    list(GET texts ${k} text)
+    string(REPLACE "@i@" "${i}" text "${text}")
+    string(REPLACE "@text@" "${text}" line "${body}")
+    string(APPEND src "void site_${i}() { ${line} }\n")
+endforeach()
+
+string(APPEND src "\nusing site_fn = void (*)();\nstatic const site_fn sites[] = {\n")
+foreach(i RANGE ${last})
+    string(APPEND src "    site_${i},\n")
+endforeach()
+string(APPEND src "};\n\nint main(int argc, char**) {\n    sites[static_cast<unsigned>(argc) % ${SITES}]();\n    return 0;\n}\n")
+
+# Only touch the file when the content changes, so rebuilds stay quiet.
+if(EXISTS "${OUT}")
+    file(READ "${OUT}" old)
+    if(old STREQUAL src)
+        return()
+    endif()
+endif()
+file(WRITE "${OUT}" "${src}")
@@ -0,0 +1,534 @@
+// Decrypt throughput benchmark
+// Author: oxunem (https://github.com/oxunem)
+// License: MIT
+//
+// Measures the decrypt paths of SecureString for literal lengths from 1 to
+// 65536 characters (powers of two), for char and wchar_t, with warm and
+// cold caches, next to a plain memcpy of the same text. Prints CSV:
+//
+//    kernel,char,n,bytes,cache,iters,ns_per_call,gb_per_s,cycles_per_byte
+//
+// bytes is the plaintext size per call, terminator included. cycles are
+// TSC ticks (empty on targets without a TSC). Each figure is the best of
+// several timed runs. "cold" rotates over enough copies of the literal and
+// its output buffers, visited in random order, to stay out of the caches.
+//
+// Kernels:
+//    memcpy     copy of the plaintext, as a baseline
+//    decrypt    decrypt() into a caller buffer
+//    in_place   encrypt_in_place() followed by decrypt_in_place()
+//    transcode  decrypt_as_utf16() for char, decrypt_as_utf8() for wchar_t
+//    append     append_to() a std::basic_string with reserved capacity
+//    chunks     write_chunks() into a caller buffer
+//
+// --counters (Linux) replaces the timing columns with hardware counters
+// read through perf_event_open, counted in user mode only:
+//
+//    kernel,char,n,bytes,cache,iters,cycles_per_byte,instructions_per_byte,
+//    ipc,l1d_misses_per_byte,llc_misses_per_byte,branch_misses_per_byte
+//
+// cycles here are core clock cycles, not TSC ticks. A counter the CPU or
+// the kernel does not provide leaves its column empty. Per-port uop counts
+// have no generic event; add them as raw, model-specific events with
+// --event NAME=CONFIG (the hex encoding from the CPU's event list, e.g.
+// port0=0x1a1 for UOPS_DISPATCHED.PORT_0 on Intel Skylake), each printed
+// as an extra NAME_per_byte column.
+//
+// The paths are checked against an independent copy of the transform by
+// secure_string_tests (tests/secure_string_tests.cpp), not here.
+//
+// Usage:
+//    secure_bench [--kernel NAME] [--max N] [--reps R] [--warm | --cold]
+//                 [--counters [--event NAME=CONFIG]...]
+//
+// Build (no dependencies besides the header):
+//    g++ -O2 -std=c++17 -I.. secure_bench.cpp
+
+#include "../secure_string.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr unsigned long long kSeed = 0x5EC0DE5EED5EC0DEULL;
+constexpr std::size_t kMaxLog = 16;
+constexpr std::size_t kColdBytes = std::size_t(64) << 20;
+constexpr std::size_t kColdMaxCopies = std::size_t(1) << 16;
+constexpr std::size_t kLine = 64;
+
+class Counters;
+
+struct Options {
+    const char* kernel = nullptr;
+    std::size_t max = std::size_t(1) << kMaxLog;
+    int reps = 5;
+    bool warm = true;
+    bool cold = true;
+    Counters* counters = nullptr;  // --counters
+};
+
+// Keep the compiler from dropping or hoisting work on p.
+inline void clobber(const void* p) {
+#if defined(_MSC_VER)
+    static const void* volatile sink;
+    sink = p;
+    _ReadWriteBarrier();
+#else
+    asm volatile("" : : "r"(p) : "memory");
+#endif
+}
+
+inline unsigned long long ticks() {
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+inline bool has_ticks() {
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+    return true;
+#else
+    return false;
+#endif
+}
+
+const char* char_name(char) { return "char"; }
+const char* char_name(wchar_t) { return "wchar_t"; }
+
+std::size_t round_up(std::size_t n) { return (n + kLine - 1) / kLine * kLine; }
+
+// Copies of one literal with their own plaintext and output buffers, laid
+// out in a single cache-line aligned arena per kind.
+template<typename CharT, std::size_t N>
+struct Pool {
+    using Lit = SecureString<CharT, N, kSeed>;
+    using String = std::basic_string<CharT>;
+
+    std::size_t copies;
+    std::size_t lit_stride, plain_stride, out_stride;
+    unsigned char* lits;
+    unsigned char* plains;
+    unsigned char* outs;
+    std::vector<String> strings;
+    std::vector<std::uint32_t> order;
+
+    explicit Pool(std::size_t n) : copies(n) {
+        lit_stride = round_up(sizeof(Lit));
+        plain_stride = round_up(N * sizeof(CharT));
+        // Worst case output: UTF-8 from UTF-32, 4 bytes per character.
+        out_stride = round_up((N + 1) * 4);
+        lits = static_cast<unsigned char*>(::operator new(lit_stride * n, std::align_val_t(kLine)));
+        plains = static_cast<unsigned char*>(::operator new(plain_stride * n, std::align_val_t(kLine)));
+        outs = static_cast<unsigned char*>(::operator new(out_stride * n, std::align_val_t(kLine)));
+
+        std::unique_ptr<CharT[]> text(new CharT[N]);
+        for (std::size_t i = 0; i + 1 < N; ++i)
+            text[i] = static_cast<CharT>('a' + i % 26);
+        text[N - 1] = 0;
+        const CharT(&input)[N] = *reinterpret_cast<const CharT(*)[N]>(text.get());
+
+        strings.resize(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            new (lits + i * lit_stride) Lit(input);
+            std::memcpy(plains + i * plain_stride, text.get(), N * sizeof(CharT));
+            std::memset(outs + i * out_stride, 0, out_stride);
+            strings[i].reserve(N);
+        }
+
+        order.resize(n);
+        for (std::size_t i = 0; i < n; ++i)
+            order[i] = static_cast<std::uint32_t>(i);
+        std::shuffle(order.begin(), order.end(), std::mt19937(12345));
+    }
+
+    ~Pool() {
+        for (std::size_t i = 0; i < copies; ++i)
+            lit(i).~Lit();
+        ::operator delete(lits, std::align_val_t(kLine));
+        ::operator delete(plains, std::align_val_t(kLine));
+        ::operator delete(outs, std::align_val_t(kLine));
+    }
+
+    Pool(const Pool&) = delete;
+    Pool& operator=(const Pool&) = delete;
+
+    Lit& lit(std::size_t i) { return *reinterpret_cast<Lit*>(lits + i * lit_stride); }
+    CharT* plain(std::size_t i) { return reinterpret_cast<CharT*>(plains + i * plain_stride); }
+    template<typename T>
+    T* out(std::size_t i) { return reinterpret_cast<T*>(outs + i * out_stride); }
+};
+
+// One call of each kernel on copy i of the pool.
+template<typename CharT, std::size_t N>
+struct Kernels {
+    using P = Pool<CharT, N>;
+
+    static void memcpy_(P& p, std::size_t i) {
+        std::memcpy(p.template out<CharT>(i), p.plain(i), N * sizeof(CharT));
+        clobber(p.template out<CharT>(i));
+    }
+
+    static void decrypt(P& p, std::size_t i) {
+        p.lit(i).decrypt(p.template out<CharT>(i));
+        clobber(p.template out<CharT>(i));
+    }
+
+    static void in_place(P& p, std::size_t i) {
+        CharT* buf = p.plain(i);
+        p.lit(i).encrypt_in_place(buf);
+        clobber(buf);
+        p.lit(i).decrypt_in_place(buf);
+        clobber(buf);
+    }
+
+    static void transcode(P& p, std::size_t i) {
+        if constexpr (sizeof(CharT) == 1) {
+            char16_t* out = p.template out<char16_t>(i);
+            p.lit(i).decrypt_as_utf16(out, N);
+            clobber(out);
+        } else {
+            char* out = p.template out<char>(i);
+            p.lit(i).decrypt_as_utf8(out, N * 4);
+            clobber(out);
+        }
+    }
+
+    static void append(P& p, std::size_t i) {
+        auto& s = p.strings[i];
+        s.clear();
+        p.lit(i).append_to(s);
+        clobber(s.data());
+    }
+
+    static void chunks(P& p, std::size_t i) {
+        CharT* out = p.template out<CharT>(i);
+        p.lit(i).write_chunks([&](const CharT* c, secure_u64 count) {
+            std::memcpy(out, c, count * sizeof(CharT));
+            out += count;
+            return true;
+        });
+        clobber(p.template out<CharT>(i));
+    }
+};
+
+struct Sample {
+    unsigned long long iters;
+    double ns;
+    double cycles;
+};
+
+// Make iters calls, cycling through the pool in its shuffled order (cold)
+// or always using copy 0 (warm).
+template<typename P, typename F>
+void run_calls(P& p, F f, unsigned long long iters, bool cold) {
+    const std::size_t n = p.copies;
+    if (cold) {
+        std::size_t k = 0;
+        for (unsigned long long it = 0; it < iters; ++it) {
+            f(p, p.order[k]);
+            if (++k == n)
+                k = 0;
+        }
+    } else {
+        for (unsigned long long it = 0; it < iters; ++it)
+            f(p, 0);
+    }
+}
+
+template<typename P, typename F>
+Sample time_calls(P& p, F f, unsigned long long iters, bool cold) {
+    const auto t0 = std::chrono::steady_clock::now();
+    const unsigned long long c0 = ticks();
+    run_calls(p, f, iters, cold);
+    const unsigned long long c1 = ticks();
+    const auto t1 = std::chrono::steady_clock::now();
+    return { iters, static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count()),
+             static_cast<double>(c1 - c0) };
+}
+
+// Grow the iteration count until one run takes at least 2 ms, and in the
+// cold case until it covers every copy at least once.
+template<typename P, typename F>
+unsigned long long calibrate(P& p, F f, bool cold) {
+    unsigned long long iters = 1;
+    for (;;) {
+        Sample s = time_calls(p, f, iters, cold);
+        if (s.ns >= 2e6 && (!cold || iters >= p.copies))
+            return iters;
+        iters *= 2;
+    }
+}
+
+template<typename P, typename F>
+Sample measure(P& p, F f, bool cold, int reps) {
+    const unsigned long long iters = calibrate(p, f, cold);
+    Sample best = time_calls(p, f, iters, cold);
+    for (int r = 1; r < reps; ++r) {
+        Sample s = time_calls(p, f, iters, cold);
+        if (s.ns < best.ns)
+            best = s;
+    }
+    return best;
+}
+
+// ---- Hardware counters ---------------------------------------------------
+
+// A set of perf events counting the calling thread in user mode. Events
+// are opened one by one rather than as a group, so one the CPU lacks does
+// not take the others with it; the kernel multiplexes them if there are
+// more than counters, and values are scaled by the time each one ran.
+class Counters {
+public:
+    Counters() {
+#if defined(__linux__)
+        add("cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+        add("instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+        add("l1d_misses", PERF_TYPE_HW_CACHE,
+            PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+        add("llc_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+        add("branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+#endif
+    }
+
+    ~Counters() {
+#if defined(__linux__)
+        for (const Event& e : events_)
+            if (e.fd >= 0)
+                close(e.fd);
+#endif
+    }
+
+    Counters(const Counters&) = delete;
+    Counters& operator=(const Counters&) = delete;
+
+    // A raw, model-specific event (--event NAME=CONFIG).
+    void add_raw(std::string name, unsigned long long config) {
+#if defined(__linux__)
+        add(std::move(name), PERF_TYPE_RAW, config);
+#else
+        (void)name;
+        (void)config;
+#endif
+    }
+
+    // Open every event. Returns false when none could be opened.
+    bool open() {
+        bool any = false;
+#if defined(__linux__)
+        for (Event& e : events_) {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = e.type;
+            attr.config = e.config;
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            e.fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+            any |= e.fd >= 0;
+        }
+#endif
+        return any;
+    }
+
+    void start() {
+#if defined(__linux__)
+        for (const Event& e : events_)
+            if (e.fd >= 0) {
+                ioctl(e.fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(e.fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+#endif
+    }
+
+    // Stop counting and read the scaled counts; -1 for events that are not
+    // available or never got scheduled.
+    void stop(std::vector<double>& values) {
+        values.assign(events_.size(), -1);
+#if defined(__linux__)
+        for (const Event& e : events_)
+            if (e.fd >= 0)
+                ioctl(e.fd, PERF_EVENT_IOC_DISABLE, 0);
+        for (std::size_t i = 0; i < events_.size(); ++i) {
+            unsigned long long v[3];  // value, time enabled, time running
+            if (events_[i].fd < 0 || read(events_[i].fd, v, sizeof(v)) != static_cast<ssize_t>(sizeof(v)) || !v[2])
+                continue;
+            values[i] = static_cast<double>(v[0]) * static_cast<double>(v[1]) / static_cast<double>(v[2]);
+        }
+#endif
+    }
+
+    std::size_t size() const { return events_.size(); }
+    const std::string& name(std::size_t i) const { return events_[i].name; }
+
+private:
+    struct Event {
+        std::string name;
+        unsigned type;
+        unsigned long long config;
+        int fd;
+    };
+
+    void add(std::string name, unsigned type, unsigned long long config) {
+        events_.push_back({ std::move(name), type, config, -1 });
+    }
+
+    std::vector<Event> events_;
+};
+
+// Count the same number of calls as the timed runs, and keep the run with
+// the fewest cycles (the first event), or the last when cycles are missing.
+template<typename P, typename F>
+unsigned long long count_calls(P& p, F f, bool cold, int reps, Counters& c, std::vector<double>& best) {
+    const unsigned long long iters = calibrate(p, f, cold);
+    std::vector<double> values;
+    best.clear();
+    for (int r = 0; r < reps; ++r) {
+        c.start();
+        run_calls(p, f, iters, cold);
+        c.stop(values);
+        if (best.empty() || values[0] < 0 || values[0] < best[0])
+            best = values;
+    }
+    return iters;
+}
+
+void print_counters(const std::vector<double>& v, unsigned long long iters, std::size_t bytes) {
+    const double total = static_cast<double>(iters) * static_cast<double>(bytes);
+    auto per_byte = [&](double x) {
+        if (x >= 0)
+            std::printf(",%.4f", x / total);
+        else
+            std::printf(",");
+    };
+    per_byte(v[0]);
+    per_byte(v[1]);
+    if (v[0] > 0 && v[1] >= 0)
+        std::printf(",%.3f", v[1] / v[0]);
+    else
+        std::printf(",");
+    for (std::size_t i = 2; i < v.size(); ++i)
+        per_byte(v[i]);
+    std::printf("\n");
+}
+
+template<typename CharT, std::size_t N>
+void run_length(const Options& opt) {
+    using K = Kernels<CharT, N>;
+    using P = Pool<CharT, N>;
+    static const std::pair<const char*, void (*)(P&, std::size_t)> kernels[] = {
+        { "memcpy", &K::memcpy_ },     { "decrypt", &K::decrypt }, { "in_place", &K::in_place },
+        { "transcode", &K::transcode }, { "append", &K::append },   { "chunks", &K::chunks },
+    };
+    const std::size_t bytes = N * sizeof(CharT);
+
+    for (int pass = 0; pass < 2; ++pass) {
+        const bool cold = pass == 1;
+        if ((cold && !opt.cold) || (!cold && !opt.warm))
+            continue;
+        const std::size_t per_copy = round_up(sizeof(typename P::Lit)) + round_up(bytes) + round_up((N + 1) * 4);
+        const std::size_t copies = cold ? std::min(kColdMaxCopies, (kColdBytes + per_copy - 1) / per_copy) : 1;
+        P pool(copies);
+
+        for (const auto& k : kernels) {
+            if (opt.kernel && std::strcmp(opt.kernel, k.first) != 0)
+                continue;
+            if (opt.counters) {
+                std::vector<double> values;
+                const unsigned long long iters = count_calls(pool, k.second, cold, opt.reps, *opt.counters, values);
+                std::printf("%s,%s,%zu,%zu,%s,%llu", k.first, char_name(CharT()), N, bytes, cold ? "cold" : "warm", iters);
+                print_counters(values, iters, bytes);
+                std::fflush(stdout);
+                continue;
+            }
+            const Sample s = measure(pool, k.second, cold, opt.reps);
+            const double per_call = s.ns / static_cast<double>(s.iters);
+            std::printf("%s,%s,%zu,%zu,%s,%llu,%.2f,%.3f,", k.first, char_name(CharT()), N, bytes, cold ? "cold" : "warm",
+                        s.iters, per_call, static_cast<double>(bytes) / per_call);
+            if (has_ticks())
+                std::printf("%.3f\n", s.cycles / static_cast<double>(s.iters) / static_cast<double>(bytes));
+            else
+                std::printf("\n");
+            std::fflush(stdout);
+        }
+    }
+}
+
+template<typename CharT, std::size_t... L>
+void run_all(const Options& opt, std::index_sequence<L...>) {
+    (((std::size_t(1) << L) <= opt.max ? run_length<CharT, std::size_t(1) << L>(opt) : void()), ...);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opt;
+    Counters counters;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--kernel") == 0 && i + 1 < argc)
+            opt.kernel = argv[++i];
+        else if (std::strcmp(argv[i], "--max") == 0 && i + 1 < argc)
+            opt.max = static_cast<std::size_t>(std::strtoull(argv[++i], nullptr, 10));
+        else if (std::strcmp(argv[i], "--reps") == 0 && i + 1 < argc)
+            opt.reps = std::max(1, std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--warm") == 0)
+            opt.cold = false;
+        else if (std::strcmp(argv[i], "--cold") == 0)
+            opt.warm = false;
+        else if (std::strcmp(argv[i], "--counters") == 0)
+            opt.counters = &counters;
+        else if (std::strcmp(argv[i], "--event") == 0 && i + 1 < argc && std::strchr(argv[i + 1], '=')) {
+            const char* arg = argv[++i];
+            const char* eq = std::strchr(arg, '=');
+            counters.add_raw(std::string(arg, eq), std::strtoull(eq + 1, nullptr, 0));
+        } else {
+            std::fprintf(stderr, "usage: secure_bench [--kernel NAME] [--max N] [--reps R] [--warm | --cold]\n"
+                                 "                    [--counters [--event NAME=CONFIG]...]\n");
+            return 2;
+        }
+    }
+
+    if (opt.counters) {
+        if (!counters.open()) {
+            std::fprintf(stderr, "secure_bench: no hardware counters available (perf_event_open failed; "
+                                 "check /proc/sys/kernel/perf_event_paranoid)\n");
+            return 1;
+        }
+        std::printf("kernel,char,n,bytes,cache,iters,cycles_per_byte,instructions_per_byte,ipc");
+        for (std::size_t i = 2; i < counters.size(); ++i)
+            std::printf(",%s_per_byte", counters.name(i).c_str());
+        std::printf("\n");
+    } else {
+        std::printf("kernel,char,n,bytes,cache,iters,ns_per_call,gb_per_s,cycles_per_byte\n");
+    }
+    run_all<char>(opt, std::make_index_sequence<kMaxLog + 1>());
+    run_all<wchar_t>(opt, std::make_index_sequence<kMaxLog + 1>());
+    return 0;
+}
@@ -0,0 +1,258 @@
+// Freestanding build check and benchmark
+// Author: oxunem (https://github.com/oxunem)
+// License: MIT
+//
+// Built with -ffreestanding -nostdlib and linked statically against
+// nothing at all: no libc, no libgcc, no C++ runtime. The program brings
+// its own _start and system calls, so any call the header or the compiler
+// makes into a runtime library (memcpy, memset, __cxa_guard_acquire,
+// __stack_chk_fail, __udivti3, ...) is an undefined symbol and fails the
+// link. That keeps the "no CRT" claim for kernel-mode use honest.
+//
+// At runtime it checks the decrypt paths against the plaintext, then
+// times them with rdtsc and prints CSV:
+//
+//    kernel,char,n,bytes,cycles_per_byte
+//
+// Exits with status 1 if a check fails. Linux x86-64 only.
+//
+// Build:
+//    g++ -std=c++17 -O2 -ffreestanding -nostdlib -static -fno-pie -no-pie -fno-exceptions -fno-rtti
+//        -fno-stack-protector -fno-asynchronous-unwind-tables -I.. secure_freestanding.cpp
+
+#if !defined(__x86_64__) || !defined(__linux__)
+#error "secure_freestanding targets Linux x86-64"
+#endif
+
+#include "../secure_string.hpp"
+
+#include <x86intrin.h>
+
+namespace {
+
+// ---- System calls and output ----------------------------------------------
+
+long sys_write(int fd, const void* p, unsigned long n) {
+    long ret;
+    asm volatile("syscall" : "=a"(ret) : "a"(1L), "D"(static_cast<long>(fd)), "S"(p), "d"(n) : "rcx", "r11", "memory");
+    return ret;
+}
+
+[[noreturn]] void sys_exit(int code) {
+    asm volatile("syscall" : : "a"(231L), "D"(static_cast<long>(code)) : "rcx", "r11", "memory");
+    __builtin_unreachable();
+}
+
+struct Out {
+    char buf[4096];
+    unsigned long len;
+
+    void flush() {
+        for (unsigned long done = 0; done < len;) {
+            long n = sys_write(1, buf + done, len - done);
+            if (n <= 0)
+                break;
+            done += static_cast<unsigned long>(n);
+        }
+        len = 0;
+    }
+
+    Out& put(char c) {
+        if (len == sizeof(buf))
+            flush();
+        buf[len++] = c;
+        return *this;
+    }
+
+    Out& str(const char* s) {
+        while (*s)
+            put(*s++);
+        return *this;
+    }
+
+    Out& num(unsigned long long v) {
+        char d[20];
+        int n = 0;
+        do {
+            d[n++] = static_cast<char>('0' + v % 10);
+            v /= 10;
+        } while (v);
+        while (n)
+            put(d[--n]);
+        return *this;
+    }
+
+    // v / 100 with two decimals.
+    Out& fixed2(unsigned long long v) {
+        num(v / 100).put('.');
+        return put(static_cast<char>('0' + v / 10 % 10)).put(static_cast<char>('0' + v % 10));
+    }
+};
+
+Out out;
+int failures;
+
+template<typename A, typename B>
+bool same(const A* a, const B* b, secure_u64 n) {
+    for (secure_u64 i = 0; i < n; ++i)
+        if (static_cast<unsigned long>(a[i]) != static_cast<unsigned long>(b[i]))
+            return false;
+    return true;
+}
+
+void check(bool ok, const char* what) {
+    out.str(ok ? "ok   " : "FAIL ").str(what).put('\n');
+    if (!ok)
+        ++failures;
+}
+
+// ---- Checks ----------------------------------------------------------------
+
+void run_checks() {
+    check(same(ENC_STR("freestanding"), "freestanding", 13), "ENC_STR");
+    check(same(ENC_WSTR(L"wide é中"), L"wide é中", 8), "ENC_WSTR");
+    check(same(ENC_U16STR(u"При"), u"При", 4), "ENC_U16STR");
+    check(same(ENC_U32STR(U"\U0001F600!"), U"\U0001F600!", 3), "ENC_U32STR");
+
+    auto& b = ENC_BUF("cached");
+    const char* p = b.get(1);
+    const bool first = same(p, "cached", 7);
+    b.sweep(100, 10);
+    check(first && b.is_sealed() && same(b.get(101), "cached", 7), "ENC_BUF get/sweep");
+
+    char buf[16];
+    const auto& lit = ENC_LIT("in place text");
+    lit.decrypt(buf);
+    lit.encrypt_in_place(buf);
+    const bool sealed = !same(buf, "in place text", 14);
+    check(sealed && lit.decrypt_in_place(buf) && same(buf, "in place text", 14), "encrypt/decrypt_in_place");
+
+    char16_t u16[16];
+    check(ENC_LIT(u8"über").decrypt_as_utf16(u16, 16) == 4 && same(u16, u"über", 5), "decrypt_as_utf16");
+    char u8[16];
+    check(ENC_LIT(U"über").decrypt_as_utf8(u8, 16) == 5 && same(u8, u8"über", 6), "decrypt_as_utf8");
+
+    char joined[600];
+    secure_u64 len = 0;
+    const bool chunked = ENC_LIT("0123456789abcdefghijklmnopqrstuvwxyz0123456789abcdefghijklmnopqrstuvwxyz"
+                                 "0123456789abcdefghijklmnopqrstuvwxyz0123456789abcdefghijklmnopqrstuvwxyz"
+                                 "0123456789abcdefghijklmnopqrstuvwxyz0123456789abcdefghijklmnopqrstuvwxyz"
+                                 "0123456789abcdefghijklmnopqrstuvwxyz0123456789abcdefghijklmnopqrstuvwxyz")
+                             .write_chunks([&](const char* c, secure_u64 n) {
+                                 for (secure_u64 i = 0; i < n && len < sizeof(joined); ++i)
+                                     joined[len++] = c[i];
+                                 return true;
+                             });
+    bool chunks_ok = chunked && len == 288;
+    for (secure_u64 i = 0; chunks_ok && i < len; ++i)
+        chunks_ok = joined[i] == "0123456789abcdefghijklmnopqrstuvwxyz"[i % 36];
+    check(chunks_ok, "write_chunks");
+
+    char line[64];
+    const secure_u64 n = enc_format(line, ENC_FMT("%s=%d (0x%04x)"), "id", -42, 0xbeef);
+    check(n == 15 && same(line, "id=-42 (0xbeef)", 16), "enc_format");
+}
+
+// ---- Benchmark -------------------------------------------------------------
+
+template<typename CharT, secure_u64 N>
+struct Text {
+    CharT data[N];
+};
+
+template<typename CharT, secure_u64 N>
+constexpr Text<CharT, N> make_text() {
+    Text<CharT, N> t{};
+    for (secure_u64 i = 0; i + 1 < N; ++i)
+        t.data[i] = static_cast<CharT>('a' + i % 26);
+    return t;
+}
+
+const char* char_name(char) { return "char"; }
+const char* char_name(wchar_t) { return "wchar_t"; }
+
+template<typename F>
+unsigned long long best_of(F f, unsigned long long iters) {
+    unsigned long long best = ~0ULL;
+    for (int r = 0; r < 5; ++r) {
+        const unsigned long long t0 = __rdtsc();
+        for (unsigned long long i = 0; i < iters; ++i)
+            f();
+        const unsigned long long t = __rdtsc() - t0;
+        if (t < best)
+            best = t;
+    }
+    return best;
+}
+
+void report(const char* kernel, const char* type, secure_u64 n, secure_u64 bytes, unsigned long long ticks,
+            unsigned long long iters) {
+    out.str(kernel).put(',').str(type).put(',').num(n).put(',').num(bytes).put(',');
+    out.fixed2(ticks * 100 / (iters * bytes)).put('\n');
+}
+
+template<typename CharT, secure_u64 N>
+void bench_length() {
+    static constexpr Text<CharT, N> text = make_text<CharT, N>();
+    static constexpr SecureString<CharT, N, 0x5EC0DE5EED5EC0DEULL ^ N> lit(text.data);
+    static CharT buf[N];
+    constexpr secure_u64 bytes = N * sizeof(CharT);
+    const unsigned long long iters = 1 + (1 << 20) / bytes;
+
+    auto decrypt = [&] {
+        lit.decrypt(buf);
+        asm volatile("" : : "r"(buf) : "memory");
+    };
+    report("decrypt", char_name(CharT()), N, bytes, best_of(decrypt, iters), iters);
+    if (!same(buf, text.data, N))
+        check(false, "bench decrypt");
+
+    auto in_place = [&] {
+        lit.encrypt_in_place(buf);
+        asm volatile("" : : "r"(buf) : "memory");
+        lit.decrypt_in_place(buf);
+        asm volatile("" : : "r"(buf) : "memory");
+    };
+    report("in_place", char_name(CharT()), N, bytes, best_of(in_place, iters), iters);
+
+    auto chunks = [&] {
+        CharT* o = buf;
+        lit.write_chunks([&](const CharT* c, secure_u64 count) {
+            for (secure_u64 i = 0; i < count; ++i)
+                o[i] = c[i];
+            o += count;
+            return true;
+        });
+        asm volatile("" : : "r"(buf) : "memory");
+    };
+    report("chunks", char_name(CharT()), N, bytes, best_of(chunks, iters), iters);
+}
+
+template<typename CharT>
+void bench_type() {
+    bench_length<CharT, 16>();
+    bench_length<CharT, 64>();
+    bench_length<CharT, 256>();
+    bench_length<CharT, 1024>();
+    bench_length<CharT, 4096>();
+}
+
+} // namespace
+
+extern "C" [[noreturn]] void secure_freestanding_main() {
+    run_checks();
+    out.str("kernel,char,n,bytes,cycles_per_byte\n");
+    bench_type<char>();
+    bench_type<wchar_t>();
+    out.flush();
+    sys_exit(failures ? 1 : 0);
+}
+
+// The kernel enters with the stack 16-byte aligned; clear the frame
+// pointer and call main as a normal function would be called.
+asm(".globl _start\n"
+    "_start:\n"
+    "    xor %rbp, %rbp\n"
+    "    and $-16, %rsp\n"
+    "    call secure_freestanding_main\n"
+    "    hlt\n");
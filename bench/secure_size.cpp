@@ -0,0 +1,124 @@
+// Binary size report for generated literal programs
+// Author: oxunem (https://github.com/oxunem)
+// License: MIT
+//
+// Prints the sizes of .text, .rodata, .data and .bss and the number of
+// symbols of each ELF file given, as CSV:
+//
+//    name,text,rodata,data,bss,symbols
+//
+// Used by the secure_string_size_bench target on programs generated with
+// 1k and 10k sites per usage mode, so code growth per macro choice can be
+// tracked. Arguments are paths, optionally labelled as name=path.
+//
+// Usage:
+//    secure_size [name=]<elf>...
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace {
+
+template<typename T>
+T load(const std::vector<unsigned char>& d, std::size_t off) {
+    T v{};
+    if (off + sizeof(T) <= d.size())
+        std::memcpy(&v, d.data() + off, sizeof(T));
+    return v;
+}
+
+struct Sizes {
+    std::uint64_t text = 0, rodata = 0, data = 0, bss = 0, symbols = 0;
+};
+
+// Section sizes by name, plus the entry count of .symtab (or .dynsym when
+// the file is stripped), not counting the null symbol.
+bool elf_sizes(const std::vector<unsigned char>& d, Sizes& out) {
+    if (d.size() < 0x40 || std::memcmp(d.data(), "\x7F" "ELF", 4) != 0)
+        return false;
+    const bool is64 = d[4] == 2;
+    const std::uint64_t shoff = is64 ? load<std::uint64_t>(d, 0x28) : load<std::uint32_t>(d, 0x20);
+    const std::uint16_t shentsize = load<std::uint16_t>(d, is64 ? 0x3A : 0x2E);
+    const std::uint16_t shnum = load<std::uint16_t>(d, is64 ? 0x3C : 0x30);
+    const std::uint16_t shstrndx = load<std::uint16_t>(d, is64 ? 0x3E : 0x32);
+    if (!shoff || shstrndx >= shnum)
+        return false;
+
+    auto header = [&](std::size_t i, std::uint64_t& off, std::uint64_t& size, std::uint32_t& nm, std::uint32_t& type,
+                      std::uint64_t& entsize) {
+        const std::size_t h = shoff + i * shentsize;
+        nm = load<std::uint32_t>(d, h);
+        type = load<std::uint32_t>(d, h + 4);
+        off = is64 ? load<std::uint64_t>(d, h + 0x18) : load<std::uint32_t>(d, h + 0x10);
+        size = is64 ? load<std::uint64_t>(d, h + 0x20) : load<std::uint32_t>(d, h + 0x14);
+        entsize = is64 ? load<std::uint64_t>(d, h + 0x38) : load<std::uint32_t>(d, h + 0x24);
+    };
+
+    std::uint64_t stroff, strsize, entsize;
+    std::uint32_t nm, type;
+    header(shstrndx, stroff, strsize, nm, type, entsize);
+
+    std::uint64_t symtab = 0, dynsym = 0;
+    for (std::size_t i = 0; i < shnum; ++i) {
+        std::uint64_t off, size;
+        header(i, off, size, nm, type, entsize);
+        if (stroff + nm >= d.size())
+            continue;
+        const std::string name(reinterpret_cast<const char*>(d.data() + stroff + nm),
+                               strnlen(reinterpret_cast<const char*>(d.data() + stroff + nm), d.size() - (stroff + nm)));
+        if (name == ".text")
+            out.text += size;
+        else if (name == ".rodata" || name.compare(0, 8, ".rodata.") == 0)
+            out.rodata += size;
+        else if (name == ".data" || name.compare(0, 6, ".data.") == 0)
+            out.data += size;
+        else if (name == ".bss" || name.compare(0, 5, ".bss.") == 0)
+            out.bss += size;
+        if (entsize && type == 2 /* SHT_SYMTAB */)
+            symtab += size / entsize - 1;
+        else if (entsize && type == 11 /* SHT_DYNSYM */)
+            dynsym += size / entsize - 1;
+    }
+    out.symbols = symtab ? symtab : dynsym;
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::fprintf(stderr, "usage: secure_size [name=]<elf>...\n");
+        return 2;
+    }
+
+    std::printf("name,text,rodata,data,bss,symbols\n");
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i], name = arg, path = arg;
+        const std::size_t eq = arg.find('=');
+        if (eq != std::string::npos) {
+            name = arg.substr(0, eq);
+            path = arg.substr(eq + 1);
+        }
+
+        std::ifstream in(path, std::ios::binary);
+        if (!in) {
+            std::fprintf(stderr, "secure_size: cannot open %s\n", path.c_str());
+            return 1;
+        }
+        std::vector<unsigned char> d((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        Sizes s;
+        if (!elf_sizes(d, s)) {
+            std::fprintf(stderr, "secure_size: %s is not an ELF file\n", path.c_str());
+            return 1;
+        }
+        std::printf("%s,%llu,%llu,%llu,%llu,%llu\n", name.c_str(), static_cast<unsigned long long>(s.text),
+                    static_cast<unsigned long long>(s.rodata), static_cast<unsigned long long>(s.data),
+                    static_cast<unsigned long long>(s.bss), static_cast<unsigned long long>(s.symbols));
+    }
+    return 0;
+}
@@ -0,0 +1,460 @@
+// End-to-end workload benchmark
+// Author: oxunem (https://github.com/oxunem)
+// License: MIT
+//
+// A request-handler loop over 300 distinct encrypted literals, picked with
+// a Zipfian popularity distribution, run on several threads. Each request
+// renders a few literals into a response buffer. The same handler is built
+// once per way of using the header, so the modes can be compared on data:
+//
+//    static   ENC_STR, decrypting into the per-literal static buffer
+//    buffer   ENC_BUF(...).get() under a per-buffer lock, as documented for
+//             SecureBuffer (warmed up first, never swept, so this is the
+//             steady-state hit path including an uncontended lock)
+//    stack    ENC_LIT(...).decrypt() into a stack buffer, wiped after use
+//    string   ENC_LIT(...).to_string<std::string>()
+//    chunks   ENC_LIT(...).write_chunks() straight into the response
+//
+// Reports requests per second and request latency percentiles per mode.
+//
+// --stress SECONDS runs a concurrency stress test instead, meant for a
+// ThreadSanitizer build (cmake -DSECURE_STRING_SANITIZE=thread). All of
+// buffer, stack, string and chunks run at once, T threads each, starting
+// together so first uses of every literal race. Buffer mode follows the
+// documented discipline: get() and the copy out under a per-buffer lock,
+// and a sweeper thread re-seals idle buffers under the same lock, so wipes
+// and re-decrypts interleave with reads of every buffer. Every decrypted
+// literal is compared with its plaintext, outside the lock. With
+// SECURE_STRING_STATS/TIMING an observer thread takes snapshots while the
+// workers run; with SECURE_STRING_TRACE the trace is dumped once the
+// workers are done. The static mode is left out: ENC_STR shares one buffer
+// per literal between threads and races by design.
+//
+// --unsafe CASE adds one documented-unsafe use, which ThreadSanitizer must
+// report as a data race (CTest registers these as expected races):
+//
+//    get      buffer readers and the sweeper without the lock: concurrent
+//             get() calls, and wipes while another thread reads
+//    sweep    readers locked, the sweeper not: wipes while a reader copies
+//    static   ENC_STR from all threads on the shared per-literal buffer
+//
+// Usage:
+//    secure_workload [--mode NAME] [--threads T] [--requests R] [--zipf S] [--csv]
+//    secure_workload --stress SECONDS [--threads T] [--zipf S] [--unsafe get|sweep|static]
+//
+// Build (no dependencies besides the header):
+//    g++ -O2 -std=c++17 -pthread -I.. secure_workload.cpp
+
+#include "../secure_string.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Literal texts of a few typical lengths, chosen by the last digit of the
+// site number.
+#define BENCH_SHORT(n) "key." #n
+#define BENCH_MEDIUM(n) "handler " #n ": request accepted"
+#define BENCH_LONG(n) "X-Service-Route-" #n ": /api/v2/tenants/{tenant}/resources/{id}?expand=owner"
+#define BENCH_HUGE(n) "site " #n " failed to validate the session token against the configured issuer; " \
+                      "falling back to the secondary key set and re-checking the signature chain"
+
+#define BENCH_D(X, p) \
+    X(p##0, BENCH_SHORT(p##0)) X(p##1, BENCH_MEDIUM(p##1)) X(p##2, BENCH_LONG(p##2)) X(p##3, BENCH_MEDIUM(p##3)) \
+    X(p##4, BENCH_SHORT(p##4)) X(p##5, BENCH_MEDIUM(p##5)) X(p##6, BENCH_LONG(p##6)) X(p##7, BENCH_HUGE(p##7)) \
+    X(p##8, BENCH_SHORT(p##8)) X(p##9, BENCH_MEDIUM(p##9))
+#define BENCH_H(X, p) \
+    BENCH_D(X, p##0) BENCH_D(X, p##1) BENCH_D(X, p##2) BENCH_D(X, p##3) BENCH_D(X, p##4) \
+    BENCH_D(X, p##5) BENCH_D(X, p##6) BENCH_D(X, p##7) BENCH_D(X, p##8) BENCH_D(X, p##9)
+
+// Site ids 1000..1299.
+#define BENCH_SITES(X) BENCH_H(X, 10) BENCH_H(X, 11) BENCH_H(X, 12)
+
+constexpr int kSites = 300;
+constexpr int kFirstSite = 1000;
+constexpr int kLiteralsPerRequest = 6;
+constexpr std::size_t kResponse = 4096;
+
+struct Response {
+    char data[kResponse];
+    std::size_t size;
+    std::size_t start;              // where the current literal begins
+    secure_u64 now;
+    // Stress test only.
+    bool verify;
+    bool sweep;                     // buffer mode: sweep() instead of get()
+    secure_u64 idle;
+    std::mutex* locks;              // buffer mode: one lock per site
+    unsigned long long errors;
+};
+
+inline void begin(Response& r, std::size_t n) {
+    if (r.size + n > kResponse)
+        r.size = 0;
+    r.start = r.size;
+}
+
+inline void emit(Response& r, const char* p, std::size_t n) {
+    std::memcpy(r.data + r.size, p, n);
+    r.size += n;
+}
+
+inline void expect(Response& r, const char* s, std::size_t n) {
+    if (r.verify && (r.size - r.start != n || std::memcmp(r.data + r.start, s, n) != 0))
+        ++r.errors;
+}
+
+struct SiteLock {
+    std::mutex* m;
+    SiteLock(Response& r, int site) : m(r.locks ? &r.locks[site] : nullptr) {
+        if (m)
+            m->lock();
+    }
+    ~SiteLock() {
+        if (m)
+            m->unlock();
+    }
+};
+
+#define BENCH_STATIC(n, s) \
+    case n: \
+        begin(r, sizeof(s) - 1); \
+        emit(r, ENC_STR(s), sizeof(s) - 1); \
+        expect(r, s, sizeof(s) - 1); \
+        break;
+#define BENCH_BUFFER(n, s) \
+    case n: { \
+        auto& b = ENC_BUF(s); \
+        { \
+            SiteLock lock(r, n - kFirstSite); \
+            if (r.sweep) { \
+                b.sweep(r.now, r.idle); \
+                break; \
+            } \
+            begin(r, sizeof(s) - 1); \
+            emit(r, b.get(r.now), sizeof(s) - 1); \
+        } \
+        expect(r, s, sizeof(s) - 1); \
+    } break;
+#define BENCH_STACK(n, s) \
+    case n: { \
+        char b[sizeof(s)]; \
+        ENC_LIT(s).decrypt(b); \
+        begin(r, sizeof(s) - 1); \
+        emit(r, b, sizeof(s) - 1); \
+        expect(r, s, sizeof(s) - 1); \
+        secure_wipe(b, sizeof(s)); \
+    } break;
+#define BENCH_STRING(n, s) \
+    case n: { \
+        std::string t = ENC_LIT(s).to_string<std::string>(); \
+        begin(r, t.size()); \
+        emit(r, t.data(), t.size()); \
+        expect(r, s, sizeof(s) - 1); \
+    } break;
+#define BENCH_CHUNKS(n, s) \
+    case n: \
+        begin(r, sizeof(s) - 1); \
+        ENC_LIT(s).write_chunks([&](const char* p, secure_u64 c) { \
+            emit(r, p, static_cast<std::size_t>(c)); \
+            return true; \
+        }); \
+        expect(r, s, sizeof(s) - 1); \
+        break;
+
+void use_static(Response& r, int site) {
+    switch (site + kFirstSite) { BENCH_SITES(BENCH_STATIC) }
+}
+
+void use_buffer(Response& r, int site) {
+    switch (site + kFirstSite) { BENCH_SITES(BENCH_BUFFER) }
+}
+
+void use_stack(Response& r, int site) {
+    switch (site + kFirstSite) { BENCH_SITES(BENCH_STACK) }
+}
+
+void use_string(Response& r, int site) {
+    switch (site + kFirstSite) { BENCH_SITES(BENCH_STRING) }
+}
+
+void use_chunks(Response& r, int site) {
+    switch (site + kFirstSite) { BENCH_SITES(BENCH_CHUNKS) }
+}
+
+struct Mode {
+    const char* name;
+    void (*use)(Response&, int);
+    bool locked;                    // shared state: take the per-site lock
+};
+
+const Mode kModes[] = {
+    { "static", &use_static, false }, { "buffer", &use_buffer, true }, { "stack", &use_stack, false },
+    { "string", &use_string, false }, { "chunks", &use_chunks, false },
+};
+
+struct Options {
+    const char* mode = nullptr;
+    unsigned threads = 4;
+    unsigned long long requests = 200000;   // per thread
+    double zipf = 1.0;
+    bool csv = false;
+    double stress = 0;                      // seconds, 0 = benchmark
+    const char* unsafe = nullptr;           // stress: documented-unsafe case to add
+};
+
+// Site sequence for one thread, drawn up front so the timed loop does not
+// pay for the random number generator.
+std::vector<std::uint16_t> zipf_sequence(std::size_t count, double s, unsigned seed) {
+    std::vector<double> cdf(kSites);
+    double sum = 0;
+    for (int i = 0; i < kSites; ++i)
+        cdf[i] = (sum += 1.0 / std::pow(i + 1, s));
+    // Popularity rank i maps to a scattered site, so hot literals are not
+    // adjacent in the binary.
+    std::vector<std::uint16_t> rank(kSites);
+    for (int i = 0; i < kSites; ++i)
+        rank[i] = static_cast<std::uint16_t>(i);
+    std::shuffle(rank.begin(), rank.end(), std::mt19937(7));
+
+    std::mt19937_64 rng(seed);
+    std::uniform_real_distribution<double> u(0, sum);
+    std::vector<std::uint16_t> out(count);
+    for (auto& v : out)
+        v = rank[std::lower_bound(cdf.begin(), cdf.end(), u(rng)) - cdf.begin()];
+    return out;
+}
+
+struct Result {
+    double seconds;
+    std::vector<std::uint32_t> latency;   // ns per request, all threads
+    unsigned long long checksum;
+};
+
+Result run_mode(const Mode& mode, const Options& opt, const std::vector<std::vector<std::uint16_t>>& seq) {
+    Result res{};
+    std::vector<std::vector<std::uint32_t>> lat(opt.threads);
+    std::vector<unsigned long long> sums(opt.threads);
+    std::vector<std::mutex> locks(kSites);
+    std::atomic<unsigned> ready{ 0 };
+    std::atomic<bool> go{ false };
+
+    std::vector<std::thread> pool;
+    for (unsigned t = 0; t < opt.threads; ++t) {
+        pool.emplace_back([&, t] {
+            Response r{};
+            r.locks = mode.locked ? locks.data() : nullptr;
+            const std::uint16_t* s = seq[t].data();
+            std::vector<std::uint32_t>& l = lat[t];
+            l.resize(opt.requests);
+            ready.fetch_add(1);
+            while (!go.load(std::memory_order_acquire)) {}
+
+            for (unsigned long long q = 0; q < opt.requests; ++q) {
+                const auto t0 = std::chrono::steady_clock::now();
+                r.size = 0;
+                for (int k = 0; k < kLiteralsPerRequest; ++k)
+                    mode.use(r, *s++);
+                const auto t1 = std::chrono::steady_clock::now();
+                l[q] = static_cast<std::uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count());
+                sums[t] += static_cast<unsigned char>(r.data[r.size / 2]);
+            }
+        });
+    }
+
+    while (ready.load() != opt.threads) {}
+    const auto start = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+    for (auto& th : pool)
+        th.join();
+    res.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    for (unsigned t = 0; t < opt.threads; ++t) {
+        res.latency.insert(res.latency.end(), lat[t].begin(), lat[t].end());
+        res.checksum += sums[t];
+    }
+    return res;
+}
+
+// ---- Stress test -----------------------------------------------------------
+
+bool run_stress(const Options& opt, const std::vector<std::vector<std::uint16_t>>& seq) {
+    const bool unsafe_get = opt.unsafe && std::strcmp(opt.unsafe, "get") == 0;
+    const bool unsafe_sweep = unsafe_get || (opt.unsafe && std::strcmp(opt.unsafe, "sweep") == 0);
+    const bool unsafe_static = opt.unsafe && std::strcmp(opt.unsafe, "static") == 0;
+    std::vector<const Mode*> modes = { &kModes[1], &kModes[2], &kModes[3], &kModes[4] };
+    if (unsafe_static)
+        modes.push_back(&kModes[0]);
+    std::vector<std::mutex> locks(kSites);
+    std::atomic<unsigned long long> clock{ 1 };
+    std::atomic<unsigned long long> errors{ 0 }, requests{ 0 };
+    std::atomic<bool> go{ false }, stop{ false };
+    std::atomic<unsigned> ready{ 0 };
+
+    std::vector<std::thread> pool;
+    for (const Mode* m : modes) {
+        for (unsigned t = 0; t < opt.threads; ++t) {
+            pool.emplace_back([&, m, t] {
+                Response r{};
+                r.verify = true;
+                r.locks = m->locked && !unsafe_get ? locks.data() : nullptr;
+                const std::vector<std::uint16_t>& s = seq[t];
+                ready.fetch_add(1);
+                while (!go.load(std::memory_order_acquire)) {}
+
+                unsigned long long q = 0;
+                for (std::size_t k = 0; !stop.load(std::memory_order_relaxed); ++q) {
+                    r.now = clock.load(std::memory_order_relaxed);
+                    r.size = 0;
+                    for (int i = 0; i < kLiteralsPerRequest; ++i, ++k)
+                        m->use(r, s[k % s.size()]);
+                }
+                errors.fetch_add(r.errors);
+                requests.fetch_add(q);
+            });
+        }
+    }
+
+    // Re-seal buffers that have been idle for two ticks, under the same
+    // per-site locks the readers take.
+    pool.emplace_back([&] {
+        Response r{};
+        r.sweep = true;
+        r.idle = 2;
+        r.locks = unsafe_sweep ? nullptr : locks.data();
+        ready.fetch_add(1);
+        while (!go.load(std::memory_order_acquire)) {}
+        while (!stop.load(std::memory_order_relaxed)) {
+            r.now = clock.fetch_add(1, std::memory_order_relaxed) + 1;
+            for (int site = 0; site < kSites; ++site)
+                use_buffer(r, site);
+        }
+    });
+
+    // Instrumentation readers run concurrently with the writers.
+    pool.emplace_back([&] {
+        ready.fetch_add(1);
+        while (!go.load(std::memory_order_acquire)) {}
+        while (!stop.load(std::memory_order_relaxed)) {
+#if defined(SECURE_STRING_STATS)
+            std::vector<SecureSiteStats> st(kSites * 5 + 1);
+            SecureStats::snapshot(st.data(), static_cast<unsigned int>(st.size()));
+            SecureStats::footprint();
+#endif
+#if defined(SECURE_STRING_TIMING)
+            SecureLatency l;
+            for (unsigned int c = 0; c < SecureTiming::Classes; ++c)
+                SecureTiming::snapshot(SecureKernelDecrypt, c, l);
+#endif
+            std::this_thread::yield();
+        }
+    });
+
+    const unsigned total = static_cast<unsigned>(pool.size());
+    while (ready.load() != total) {}
+    go.store(true, std::memory_order_release);
+    std::this_thread::sleep_for(std::chrono::duration<double>(opt.stress));
+    stop.store(true);
+    for (auto& th : pool)
+        th.join();
+
+#if defined(SECURE_STRING_TRACE)
+    FILE* devnull = std::fopen("/dev/null", "w");
+    if (devnull) {
+        SecureTrace::dump(devnull);
+        std::fclose(devnull);
+    }
+#endif
+
+    std::printf("stress: %u threads x %zu modes, %llu requests, %llu sweeps, %llu mismatches\n", opt.threads,
+                modes.size(), requests.load(), clock.load() - 1, errors.load());
+    return errors.load() == 0;
+}
+
+std::uint32_t percentile(std::vector<std::uint32_t>& v, double p) {
+    const std::size_t k = std::min(v.size() - 1, static_cast<std::size_t>(p * static_cast<double>(v.size())));
+    std::nth_element(v.begin(), v.begin() + k, v.end());
+    return v[k];
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opt;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--mode") == 0 && i + 1 < argc)
+            opt.mode = argv[++i];
+        else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            opt.threads = std::max(1u, static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10)));
+        else if (std::strcmp(argv[i], "--requests") == 0 && i + 1 < argc)
+            opt.requests = std::max(1ull, std::strtoull(argv[++i], nullptr, 10));
+        else if (std::strcmp(argv[i], "--zipf") == 0 && i + 1 < argc)
+            opt.zipf = std::strtod(argv[++i], nullptr);
+        else if (std::strcmp(argv[i], "--csv") == 0)
+            opt.csv = true;
+        else if (std::strcmp(argv[i], "--stress") == 0 && i + 1 < argc)
+            opt.stress = std::strtod(argv[++i], nullptr);
+        else if (std::strcmp(argv[i], "--unsafe") == 0 && i + 1 < argc &&
+                 (std::strcmp(argv[i + 1], "get") == 0 || std::strcmp(argv[i + 1], "sweep") == 0 ||
+                  std::strcmp(argv[i + 1], "static") == 0))
+            opt.unsafe = argv[++i];
+        else {
+            std::fprintf(stderr, "usage: secure_workload [--mode NAME] [--threads T] [--requests R] [--zipf S] [--csv]\n"
+                                 "       secure_workload --stress SECONDS [--threads T] [--zipf S] [--unsafe get|sweep|static]\n");
+            return 2;
+        }
+    }
+
+    std::vector<std::vector<std::uint16_t>> seq(opt.threads);
+    const std::size_t draws = opt.stress > 0 ? 1 << 16 : static_cast<std::size_t>(opt.requests * kLiteralsPerRequest);
+    for (unsigned t = 0; t < opt.threads; ++t)
+        seq[t] = zipf_sequence(draws, opt.zipf, 1000 + t);
+
+    if (opt.stress > 0)
+        return run_stress(opt, seq) ? 0 : 1;
+
+    // Unseal every buffer once before timing, so the buffer mode measures
+    // the hit path.
+    Response warm{};
+    for (int site = 0; site < kSites; ++site) {
+        warm.size = 0;
+        use_buffer(warm, site);
+    }
+
+    if (opt.csv)
+        std::printf("mode,threads,requests,req_per_s,p50_ns,p99_ns,p999_ns\n");
+    else
+        std::printf("%-8s %8s %12s %14s %9s %9s %9s\n", "mode", "threads", "requests", "req/s", "p50 ns", "p99 ns", "p99.9 ns");
+
+    unsigned long long checksum = 0;
+    for (const Mode& m : kModes) {
+        if (opt.mode && std::strcmp(opt.mode, m.name) != 0)
+            continue;
+        Result r = run_mode(m, opt, seq);
+        checksum += r.checksum;
+        const unsigned long long total = opt.requests * opt.threads;
+        const double rate = static_cast<double>(total) / r.seconds;
+        const std::uint32_t p50 = percentile(r.latency, 0.50);
+        const std::uint32_t p99 = percentile(r.latency, 0.99);
+        const std::uint32_t p999 = percentile(r.latency, 0.999);
+        if (opt.csv)
+            std::printf("%s,%u,%llu,%.0f,%u,%u,%u\n", m.name, opt.threads, total, rate, p50, p99, p999);
+        else
+            std::printf("%-8s %8u %12llu %14.0f %9u %9u %9u\n", m.name, opt.threads, total, rate, p50, p99, p999);
+        std::fflush(stdout);
+    }
+    std::fprintf(stderr, "checksum %llu\n", checksum);
+    return 0;
+}
@@ -0,0 +1,56 @@
+// libFuzzer entry point
+// Author: oxunem (https://github.com/oxunem)
+// License: MIT
+//
+// Runs the differential checks of tests/secure_verify.hpp on fuzzer input.
+// The first two bytes pick the character type and the (length, seed) case;
+// the rest is the text, sizeof(CharT) bytes per character, mapped onto
+// valid non-terminator characters and repeated or cut to the case length.
+// A mismatch aborts, which libFuzzer reports as a crash.
+//
+// Build (Clang):
+//    cmake -S . -B build-fuzz -DCMAKE_CXX_COMPILER=clang++ -DSECURE_STRING_BUILD_FUZZ=ON
+//    cmake --build build-fuzz --target secure_string_fuzz
+//    build-fuzz/secure_string_fuzz -max_total_time=60
+
+#include "../tests/secure_verify.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+
+template<typename CharT>
+void fuzz_case(Verify& v, unsigned pick, const std::uint8_t* data, std::size_t size) {
+    const VerifyCase<CharT>& c = kVerifyTable<CharT>[pick % kVerifyCases];
+    std::vector<CharT> text(c.n);
+    const std::size_t w = sizeof(CharT);
+    for (std::size_t i = 0; i + 1 < c.n; ++i) {
+        unsigned long long r = 0;
+        for (std::size_t b = 0; b < w && size; ++b)
+            r |= static_cast<unsigned long long>(data[(i * w + b) % size]) << (8 * b);
+        text[i] = verify_char<CharT>(r, false);
+    }
+    text[c.n - 1] = 0;
+    c.run(v, text.data());
+}
+
+} // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* data, std::size_t size) {
+    if (size < 2)
+        return 0;
+    const unsigned pick = data[0] | (data[1] << 8);
+    Verify v{ std::mt19937_64(pick) };
+    switch (pick % 4) {
+    case 0: fuzz_case<char>(v, pick / 4, data + 2, size - 2); break;
+    case 1: fuzz_case<wchar_t>(v, pick / 4, data + 2, size - 2); break;
+    case 2: fuzz_case<char16_t>(v, pick / 4, data + 2, size - 2); break;
+    default: fuzz_case<char32_t>(v, pick / 4, data + 2, size - 2); break;
+    }
+    if (v.failures)
+        std::abort();
+    return 0;
+}
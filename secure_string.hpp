@@ -11,24 +11,855 @@
 // Usage:
 //    const char* secret = ENC_STR("Hello World!");
 //    const wchar_t* secretW = ENC_WSTR(L"Hello World!");
+//    const char16_t* secret16 = ENC_U16STR(u"Hello World!");
+//    const char32_t* secret32 = ENC_U32STR(U"Hello World!");
+//
+// Optional configuration (define before including):
+//    SECURE_STRING_INTEGRITY - store a CRC32C tag of each encrypted literal
+//                              and verify it while decrypting. A tampered literal
+//                              decrypts to an all-zero buffer instead of
+//                              garbage, and decrypt() returns false.
+//    SECURE_STRING_POSIX_IO  - enable write_to(fd) and secure_writev() for
+//                              emitting literals to a file descriptor.
+//    SECURE_STRING_STAGING   - chunk size, in characters, of the stack
+//                              staging buffer used by write_chunks()
+//                              (default 256).
+//    SECURE_STRING_STATS     - per-literal call counters and plaintext
+//                              residency tracking (user mode only, uses
+//                              <atomic> and operator new). Compiles to
+//                              nothing when not defined.
+//    SECURE_STATS_MAX_SITES  - capacity of the site table (default 4096).
+//    SECURE_STATS_REPORT_AT_EXIT - print SecureStats::report() to stderr
+//                              at exit.
+//    SECURE_STRING_TIMING    - per-thread latency histograms of every
+//                              decrypt path, read with rdtscp (user mode
+//                              only).
+//    SECURE_STRING_TRACE     - record decrypt, seal and wipe events into
+//                              per-thread ring buffers and dump them as
+//                              Chrome trace JSON (user mode only).
+//    SECURE_TRACE_EVENTS     - ring capacity per thread (default 16384).
+//    SECURE_STRING_USDT      - SystemTap/USDT static probes (provider
+//                              "secure_string") for perf and bpftrace;
+//                              needs <sys/sdt.h>. A probe is a single nop
+//                              until a tracer attaches.
+//    SECURE_STRING_SEED      - base seed for reproducible builds. The
+//                              build date and time are left out of the
+//                              per-site seeds and the file name is hashed
+//                              in instead, so the same sources give the
+//                              same ciphertext and code in every build.
+//    SECURE_STRING_MANIFEST  - emit one record per ENC_* site into a
+//                              "secure_manifest" section (ELF) or
+//                              "securemf" section (PE) for build-time
+//                              statistics; read it with
+//                              tools/secure_manifest.cpp.
 // ------------------------------------------------------------
 
+// Compiler portability. MSVC has these natively; GCC and Clang get the
+// equivalent attribute and type, so the header builds unchanged on Linux.
+#if defined(_MSC_VER)
+#define SECURE_FORCEINLINE __forceinline
+#define SECURE_NOINLINE __declspec(noinline)
+typedef unsigned __int64 secure_u64;
+#else
+#define SECURE_FORCEINLINE inline __attribute__((always_inline))
+#define SECURE_NOINLINE __attribute__((noinline))
+typedef unsigned long long secure_u64;
+#endif
+
 // Rotate left 8-bit
 #define ROL8(x, r) ((unsigned char)(((x) << ((r) % 8)) | ((x) >> (8 - ((r) % 8)))))
 // Rotate right 8-bit
 #define ROR8(x, r) ((unsigned char)(((x) >> ((r) % 8)) | ((x) << (8 - ((r) % 8)))))
 
+// FNV-1a hash of the whole path, so same-named files in different
+// directories get different seeds. Map the source root away with
+// -fmacro-prefix-map to keep the seed independent of the checkout.
+constexpr secure_u64 secure_file_seed(const char* path) {
+    secure_u64 h = 0xCBF29CE484222325ULL;
+    for (; *path; ++path)
+        h = (h ^ static_cast<unsigned char>(*path)) * 0x100000001B3ULL;
+    return h;
+}
+
 // Generate a unique seed based on compile time macros.
 // Helps to have different seeds per compilation unit/line/time.
+// With SECURE_STRING_SEED the time is replaced by the seed and file path.
+#if defined(SECURE_STRING_SEED)
+#define SECURE_UNIQUE_SEED \
+    ((__LINE__ * 0xF1E2D3C4B5A69788ULL) ^ \
+     (__COUNTER__ * 0x123456789ABCDEF0ULL) ^ \
+     ((secure_u64)(SECURE_STRING_SEED) * 0x9A8B7C6D5E4F3210ULL) ^ \
+     secure_file_seed(__FILE__) ^ \
+     ((__COUNTER__ % 256) * 0xCAFEBABEDEADBEEFULL))
+#else
 #define SECURE_UNIQUE_SEED \
     ((__LINE__ * 0xF1E2D3C4B5A69788ULL) ^ \
      (__COUNTER__ * 0x123456789ABCDEF0ULL) ^ \
      ((__TIME__[7] - '0') * 0x9A8B7C6D5E4F3210ULL) ^ \
      ((__DATE__[0] << 24) | (__DATE__[4] << 16) | (__DATE__[7] << 8)) ^ \
      ((__COUNTER__ % 256) * 0xCAFEBABEDEADBEEFULL))
+#endif
+
+#ifndef SECURE_STRING_STAGING
+#define SECURE_STRING_STAGING 256
+#endif
+
+#if defined(SECURE_STRING_POSIX_IO)
+#include <errno.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+// The user-mode instrumentation shares per-thread data through atomics.
+#if defined(SECURE_STRING_STATS) || defined(SECURE_STRING_TIMING) || defined(SECURE_STRING_TRACE)
+#include <atomic>
+#endif
+
+#if defined(SECURE_STRING_INTEGRITY)
+#if defined(__SSE4_2__) || (defined(_MSC_VER) && defined(__AVX__))
+#include <nmmintrin.h>
+#define SECURE_CRC32C_HW(crc, b) _mm_crc32_u8((crc), (b))
+#elif defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define SECURE_CRC32C_HW(crc, b) __crc32cb((crc), (b))
+#endif
+#endif
+
+// CRC32C (Castagnoli) over a single byte. Bitwise so it can run at compile
+// time; at runtime the hardware CRC32 instruction is used when available.
+constexpr unsigned int secure_crc32c(unsigned int crc, unsigned char b) {
+    crc ^= b;
+    for (int k = 0; k < 8; ++k)
+        crc = (crc >> 1) ^ (0x82F63B78u & (0u - (crc & 1u)));
+    return crc;
+}
+
+SECURE_FORCEINLINE unsigned int secure_crc32c_rt(unsigned int crc, unsigned char b) {
+#if defined(SECURE_CRC32C_HW)
+    return SECURE_CRC32C_HW(crc, b);
+#else
+    return secure_crc32c(crc, b);
+#endif
+}
+
+#if defined(SECURE_STRING_POSIX_IO)
+// write() until everything is out, retrying on EINTR and short writes.
+inline bool secure_write_all(int fd, const void* p, secure_u64 n) {
+    const char* c = static_cast<const char*>(p);
+    while (n) {
+        ssize_t w = ::write(fd, c, n);
+        if (w < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        c += w;
+        n -= static_cast<secure_u64>(w);
+    }
+    return true;
+}
+#endif
+
+#if defined(SECURE_STRING_STATS) || defined(SECURE_STRING_TIMING)
+// rdtscp on x86 and x64; the steady clock elsewhere (MSVC ARM64 included).
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define SECURE_HAS_RDTSCP
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define SECURE_HAS_RDTSCP
+#else
+#include <chrono>
+#endif
+
+SECURE_FORCEINLINE unsigned long long secure_ticks() {
+#if defined(SECURE_HAS_RDTSCP)
+    unsigned int aux;
+    return __rdtscp(&aux);
+#else
+    return static_cast<unsigned long long>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+}
+#endif
+
+#if defined(SECURE_STRING_STATS) || defined(SECURE_STRING_TIMING) || defined(SECURE_STRING_TRACE)
+// Per-thread blocks of instrumentation data (Block needs in_use and next
+// members). Blocks stay on a lock-free list for the life of the process so
+// readers can walk them at any time. A thread takes a free block, or
+// allocates one, on first use and hands it back when it exits; the next new
+// thread continues counting into it, so thread churn reuses memory instead
+// of growing it and no counts are lost.
+template<typename Block>
+class SecureThreadBlocks {
+    static inline std::atomic<Block*> head{ nullptr };
+
+    static Block* acquire() {
+        for (Block* b = head.load(std::memory_order_acquire); b; b = b->next) {
+            bool expected = false;
+            if (!b->in_use.load(std::memory_order_relaxed) &&
+                b->in_use.compare_exchange_strong(expected, true, std::memory_order_acquire, std::memory_order_relaxed))
+                return b;
+        }
+        Block* b = new Block();
+        b->in_use.store(true, std::memory_order_relaxed);
+        b->next = head.load(std::memory_order_relaxed);
+        while (!head.compare_exchange_weak(b->next, b, std::memory_order_release, std::memory_order_relaxed)) {}
+        return b;
+    }
+
+    struct Owner {
+        Block* block;
+        Owner() : block(acquire()) {}
+        ~Owner() { block->in_use.store(false, std::memory_order_release); }
+    };
+
+public:
+    static Block* first() { return head.load(std::memory_order_acquire); }
+
+    static Block& local() {
+        thread_local Owner owner;
+        return *owner.block;
+    }
+};
+#endif
+
+#if defined(SECURE_STRING_STATS)
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifndef SECURE_STATS_MAX_SITES
+#define SECURE_STATS_MAX_SITES 4096
+#endif
+
+template<typename CharT, secure_u64 N, unsigned long long Seed>
+class SecureString;
+
+// Per-site statistics as returned by SecureStats::snapshot().
+struct SecureSiteStats {
+    unsigned int id;
+    const char* file;
+    unsigned int line;
+    secure_u64 bytes;         // plaintext bytes per use, terminator included
+    unsigned long long calls;
+    unsigned long long cycles;      // TSC ticks spent in this literal's decrypt paths
+    unsigned long long hits;        // SecureBuffer::get() on an unsealed buffer
+    unsigned long long misses;      // SecureBuffer::get() that had to decrypt
+};
+
+// Plaintext held by the library, as returned by SecureStats::footprint().
+// Plaintext handed to the caller (decrypt into a caller buffer, to_string,
+// enc_format, ...) belongs to the caller and is not counted.
+struct SecureFootprint {
+    unsigned long long resident;    // bytes of plaintext currently in memory
+    unsigned long long peak;        // highest value resident has reached
+    unsigned long long executed;    // static ENC_STR/ENC_BUF storage of the sites executed so far
+};
+
+// Every ENC_* expansion registers itself once and gets a compact site ID.
+// Each thread counts into its own slot array with plain (relaxed) loads and
+// stores, so the hot path has no locked instructions; snapshot() sums the
+// arrays of all threads on demand. An exiting thread's array, counts
+// included, is reused by the next new thread (see SecureThreadBlocks).
+// Site 0 collects sites beyond the table size.
+class SecureStats {
+public:
+    struct Slot {
+        std::atomic<unsigned long long> calls;
+        std::atomic<unsigned long long> cycles;
+        std::atomic<unsigned long long> hits;
+        std::atomic<unsigned long long> misses;
+    };
+
+    struct Counters {
+        Slot slots[SECURE_STATS_MAX_SITES];
+        std::atomic<bool> in_use;
+        Counters* next;
+    };
+
+private:
+    struct Site {
+        const char* file;
+        unsigned int line;
+        secure_u64 bytes;
+    };
+
+    static inline std::atomic<unsigned int> count{ 1 };
+    static inline Site table[SECURE_STATS_MAX_SITES] = { { "<overflow>", 0, 0 } };
+    static inline std::atomic<bool> ready[SECURE_STATS_MAX_SITES] = {};
+    static inline std::atomic<unsigned long long> resident_bytes{ 0 };
+    static inline std::atomic<unsigned long long> peak_bytes{ 0 };
+    static inline std::atomic<unsigned long long> executed_bytes{ 0 };
+
+    static void add(std::atomic<unsigned long long>& n, unsigned long long v) {
+        n.store(n.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+    }
+
+public:
+    static unsigned int site(const char* file, unsigned int line, secure_u64 bytes) {
+        unsigned int id = count.fetch_add(1, std::memory_order_relaxed);
+        if (id >= SECURE_STATS_MAX_SITES)
+            return 0;
+        table[id] = { file, line, bytes };
+        ready[id].store(true, std::memory_order_release);
+        return id;
+    }
+
+    // Register a site and store its ID in the site's slot. The SecureString
+    // of the site points at the slot, so costs measured inside its decrypt
+    // paths are charged to this site even if another site has the same type.
+    template<typename CharT, secure_u64 N, unsigned long long Seed>
+    static unsigned int bind(const SecureString<CharT, N, Seed>&, unsigned int& slot, const char* file, unsigned int line) {
+        slot = site(file, line, N * sizeof(CharT));
+        return slot;
+    }
+
+    static Counters& local() { return SecureThreadBlocks<Counters>::local(); }
+
+    // Recording is kept out of line so that every ENC_* site only pays for
+    // a call, not for the thread_local lookup and slot update.
+    static SECURE_NOINLINE void hit(unsigned int id) { add(local().slots[id].calls, 1); }
+    static SECURE_NOINLINE void cost(unsigned int id, unsigned long long ticks) { add(local().slots[id].cycles, ticks); }
+    static SECURE_NOINLINE void cache(unsigned int id, bool hit) { add(hit ? local().slots[id].hits : local().slots[id].misses, 1); }
+
+    // Account for plaintext entering (delta > 0) or leaving memory.
+    static SECURE_NOINLINE void resident(long long delta) {
+        unsigned long long now = resident_bytes.fetch_add(static_cast<unsigned long long>(delta), std::memory_order_relaxed) + static_cast<unsigned long long>(delta);
+        unsigned long long peak = peak_bytes.load(std::memory_order_relaxed);
+        while (now > peak && !peak_bytes.compare_exchange_weak(peak, now, std::memory_order_relaxed)) {}
+    }
+
+    // The static buffer of a site was set up on the site's first run; an
+    // ENC_STR buffer holds plaintext from then on and never gives it back.
+    // Sites that never ran are not counted (the manifest lists them all).
+    static bool reserve(secure_u64 bytes, bool plaintext) {
+        executed_bytes.fetch_add(bytes, std::memory_order_relaxed);
+        if (plaintext)
+            resident(static_cast<long long>(bytes));
+        return true;
+    }
+
+    static SecureFootprint footprint() {
+        return { resident_bytes.load(std::memory_order_relaxed), peak_bytes.load(std::memory_order_relaxed),
+                 executed_bytes.load(std::memory_order_relaxed) };
+    }
+
+    // Sum the counters of all threads into out (up to max entries, in site
+    // order). Returns the number of entries written.
+    static unsigned int snapshot(SecureSiteStats* out, unsigned int max) {
+        unsigned int sites = count.load(std::memory_order_relaxed);
+        if (sites > SECURE_STATS_MAX_SITES)
+            sites = SECURE_STATS_MAX_SITES;
+
+        unsigned int n = 0;
+        for (unsigned int id = 0; id < sites && n < max; ++id) {
+            if (id != 0 && !ready[id].load(std::memory_order_acquire))
+                continue;
+            SecureSiteStats st = { id, table[id].file, table[id].line, table[id].bytes, 0, 0, 0, 0 };
+            for (Counters* c = SecureThreadBlocks<Counters>::first(); c; c = c->next) {
+                st.calls += c->slots[id].calls.load(std::memory_order_relaxed);
+                st.cycles += c->slots[id].cycles.load(std::memory_order_relaxed);
+                st.hits += c->slots[id].hits.load(std::memory_order_relaxed);
+                st.misses += c->slots[id].misses.load(std::memory_order_relaxed);
+            }
+            if (id == 0 && !st.calls && !st.cycles)
+                continue;
+            out[n++] = st;
+        }
+        return n;
+    }
+
+    // Print every site that was used, most expensive first: calls, bytes
+    // decrypted, cycles and SecureBuffer hit ratio.
+    static void report(FILE* f) {
+        SecureSiteStats* st = new SecureSiteStats[SECURE_STATS_MAX_SITES];
+        unsigned int n = snapshot(st, SECURE_STATS_MAX_SITES);
+
+        for (unsigned int i = 1; i < n; ++i) {
+            SecureSiteStats v = st[i];
+            unsigned int j = i;
+            for (; j > 0 && st[j - 1].cycles < v.cycles; --j)
+                st[j] = st[j - 1];
+            st[j] = v;
+        }
+
+        // Sites are printed with their whole __FILE__, so same-named files in
+        // different directories stay apart.
+        int width = 40;
+        for (unsigned int i = 0; i < n; ++i) {
+            const int w = snprintf(nullptr, 0, "%s:%u", st[i].file, st[i].line);
+            if ((st[i].calls || st[i].cycles) && w > width)
+                width = w < 255 ? w : 255;
+        }
+
+        fprintf(f, "%-6s %-*s %12s %14s %14s %10s %6s\n", "id", width, "site", "calls", "bytes", "cycles", "cyc/call", "hit%");
+        for (unsigned int i = 0; i < n; ++i) {
+            const SecureSiteStats& e = st[i];
+            if (!e.calls && !e.cycles)
+                continue;
+            char where[256];
+            snprintf(where, sizeof(where), "%s:%u", e.file, e.line);
+            char ratio[16] = "-";
+            if (e.hits + e.misses)
+                snprintf(ratio, sizeof(ratio), "%.1f", 100.0 * static_cast<double>(e.hits) / static_cast<double>(e.hits + e.misses));
+            fprintf(f, "%-6u %-*s %12llu %14llu %14llu %10llu %6s\n", e.id, width, where, e.calls,
+                    e.calls * static_cast<unsigned long long>(e.bytes), e.cycles, e.calls ? e.cycles / e.calls : 0, ratio);
+        }
+        delete[] st;
+
+        SecureFootprint fp = footprint();
+        fprintf(f, "plaintext resident %llu bytes, peak %llu bytes, static buffers of executed sites %llu bytes\n", fp.resident, fp.peak,
+                fp.executed);
+    }
+
+#if defined(SECURE_STATS_REPORT_AT_EXIT)
+private:
+    static void report_at_exit() { report(stderr); }
+    static inline const int registered = atexit(report_at_exit);
+#endif
+};
+
+// Per-expansion slot for the site ID, passed to the site's SecureString.
+#define SECURE_STATS_SLOT static unsigned int secure_site_slot = 0
+#define SECURE_STATS_SLOT_PTR (&secure_site_slot)
+// Register the enclosing ENC_* expansion once, as secure_site.
+#define SECURE_STATS_SITE(crypt) [[maybe_unused]] static const unsigned int secure_site = SecureStats::bind((crypt), secure_site_slot, __FILE__, __LINE__)
+#define SECURE_STATS_HIT(site) SecureStats::hit(site)
+#define SECURE_STATS_CACHE(site, hit) SecureStats::cache((site), (hit))
+#define SECURE_STATS_RESERVE(bytes, plaintext) [[maybe_unused]] static const bool secure_reserved = SecureStats::reserve((bytes), (plaintext))
+#define SECURE_STATS_RESIDENT(delta) SecureStats::resident(delta)
+#else
+#define SECURE_STATS_SLOT
+#define SECURE_STATS_SLOT_PTR nullptr
+#define SECURE_STATS_SITE(crypt)
+#define SECURE_STATS_HIT(site) ((void)0)
+#define SECURE_STATS_CACHE(site, hit) ((void)0)
+#define SECURE_STATS_RESERVE(bytes, plaintext)
+#define SECURE_STATS_RESIDENT(delta) ((void)0)
+#endif
+
+// Decrypt paths, as seen by the instrumentation hooks
+enum SecureKernel : unsigned int {
+    SecureKernelDecrypt,            // decrypt()
+    SecureKernelUnseal,             // decrypt_in_place()
+    SecureKernelSeal,               // encrypt_in_place()
+    SecureKernelTranscode,          // decrypt_as_utf16() / decrypt_as_utf8()
+    SecureKernelAppend,             // append_to() / to_string()
+    SecureKernelChunks,             // write_chunks() / write_to()
+    SecureKernelFormat,             // enc_format()
+    SecureKernelWipe,               // secure_wipe()
+    SecureKernelCount
+};
+
+inline const char* secure_kernel_name(unsigned int k) {
+    constexpr const char* names[SecureKernelCount] = { "decrypt", "unseal", "seal", "transcode", "append", "chunks", "format", "wipe" };
+    return k < SecureKernelCount ? names[k] : "?";
+}
+
+#if defined(SECURE_STRING_TIMING)
+struct SecureLatency {
+    unsigned long long count;
+    unsigned long long p50;
+    unsigned long long p90;
+    unsigned long long p99;
+    unsigned long long p999;
+    unsigned long long max;
+};
+
+// Log-linear (HDR-style) histograms of decrypt cost in TSC ticks, one per
+// kernel and literal length class (bytes rounded down to a power of two).
+// Each bucket covers 1/8 of its power of two, so percentiles are within
+// 12.5%. Threads record into their own histograms with relaxed
+// load/store; snapshot() merges them. Histograms of exited threads are
+// reused by new threads, counts included.
+class SecureTiming {
+public:
+    static constexpr unsigned int Classes = 17;     // 1, 2, 4, ... 64K+ bytes
+    static constexpr unsigned int Sub = 8;
+    static constexpr unsigned int MaxBits = 40;     // larger values are clamped
+    static constexpr unsigned int Buckets = (MaxBits - 2) * Sub;
+
+    struct Histograms {
+        std::atomic<unsigned int> h[SecureKernelCount][Classes][Buckets];
+        std::atomic<bool> in_use;
+        Histograms* next;
+    };
+
+private:
+    static unsigned int msb(unsigned long long v) {
+        unsigned int r = 0;
+        while (v >>= 1)
+            ++r;
+        return r;
+    }
+
+public:
+    static Histograms& local() { return SecureThreadBlocks<Histograms>::local(); }
+
+    static unsigned int length_class(secure_u64 bytes) {
+        unsigned int c = bytes ? msb(bytes) : 0;
+        return c < Classes ? c : Classes - 1;
+    }
+
+    static unsigned int bucket(unsigned long long v) {
+        if (v < Sub)
+            return static_cast<unsigned int>(v);
+        unsigned int m = msb(v);
+        if (m >= MaxBits)
+            return Buckets - 1;
+        unsigned int shift = m - 3;
+        return (shift + 1) * Sub + static_cast<unsigned int>((v >> shift) & (Sub - 1));
+    }
+
+    // Highest value that falls into bucket b.
+    static unsigned long long bucket_limit(unsigned int b) {
+        if (b < Sub)
+            return b;
+        unsigned int shift = b / Sub - 1;
+        return ((static_cast<unsigned long long>(Sub + b % Sub) + 1) << shift) - 1;
+    }
+
+    // Out of line, like SecureStats::hit(); only the tick reads are inlined.
+    static SECURE_NOINLINE void record(unsigned int kernel, secure_u64 bytes, unsigned long long ticks) {
+        std::atomic<unsigned int>& n = local().h[kernel][length_class(bytes)][bucket(ticks)];
+        n.store(n.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    // Merge all threads for one kernel and length class. Returns false if
+    // nothing was recorded.
+    static bool snapshot(unsigned int kernel, unsigned int length_class, SecureLatency& out) {
+        out = {};
+        if (kernel >= SecureKernelCount || length_class >= Classes)
+            return false;
+
+        unsigned long long merged[Buckets] = {};
+        for (Histograms* t = SecureThreadBlocks<Histograms>::first(); t; t = t->next)
+            for (unsigned int b = 0; b < Buckets; ++b)
+                merged[b] += t->h[kernel][length_class][b].load(std::memory_order_relaxed);
+
+        for (unsigned int b = 0; b < Buckets; ++b)
+            out.count += merged[b];
+        if (!out.count)
+            return false;
+
+        const unsigned long long rank50 = (out.count * 500 + 999) / 1000;
+        const unsigned long long rank90 = (out.count * 900 + 999) / 1000;
+        const unsigned long long rank99 = (out.count * 990 + 999) / 1000;
+        const unsigned long long rank999 = (out.count * 999 + 999) / 1000;
+        unsigned long long seen = 0;
+        for (unsigned int b = 0; b < Buckets; ++b) {
+            if (!merged[b])
+                continue;
+            const unsigned long long before = seen;
+            seen += merged[b];
+            const unsigned long long v = bucket_limit(b);
+            if (before < rank50 && seen >= rank50) out.p50 = v;
+            if (before < rank90 && seen >= rank90) out.p90 = v;
+            if (before < rank99 && seen >= rank99) out.p99 = v;
+            if (before < rank999 && seen >= rank999) out.p999 = v;
+            out.max = v;
+        }
+        return true;
+    }
+};
+#endif
+
+#if defined(SECURE_STRING_TRACE)
+#include <chrono>
+#include <stdio.h>
+
+#ifndef SECURE_TRACE_EVENTS
+#define SECURE_TRACE_EVENTS 16384
+#endif
+
+// Per-thread ring buffers of completed probe scopes, dumped as Chrome trace
+// JSON (chrome://tracing, Perfetto). Recording is a plain store into the
+// calling thread's ring plus a release store of its position; the oldest
+// events are overwritten when a ring wraps. Rings of exited threads are
+// reused by new threads, so events carry their thread ID themselves.
+// dump() reads every ring without
+// stopping writers, so call it when decrypting threads are quiet, or accept
+// that events being written during the dump may come out torn.
+class SecureTrace {
+public:
+    struct Event {
+        unsigned long long begin;       // ns, steady clock
+        unsigned long long end;
+        unsigned long long literal;
+        secure_u64 bytes;
+        unsigned int kernel;
+        unsigned int tid;
+    };
+
+    struct Ring {
+        Event events[SECURE_TRACE_EVENTS];
+        std::atomic<unsigned long long> pos;
+        std::atomic<bool> in_use;
+        Ring* next;
+    };
+
+private:
+    static inline std::atomic<unsigned int> threads{ 0 };
+
+    static unsigned int tid() {
+        thread_local unsigned int id = threads.fetch_add(1, std::memory_order_relaxed) + 1;
+        return id;
+    }
+
+public:
+    static SECURE_FORCEINLINE unsigned long long now() {
+        return static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    static Ring& local() { return SecureThreadBlocks<Ring>::local(); }
+
+    static SECURE_NOINLINE void record(unsigned int kernel, secure_u64 bytes, unsigned long long literal,
+                                       unsigned long long begin, unsigned long long end) {
+        Ring& r = local();
+        const unsigned long long pos = r.pos.load(std::memory_order_relaxed);
+        r.events[pos % SECURE_TRACE_EVENTS] = { begin, end, literal, bytes, kernel, tid() };
+        r.pos.store(pos + 1, std::memory_order_release);
+    }
+
+    // Write all buffered events as Chrome trace JSON. Returns false on an
+    // I/O error.
+    static bool dump(FILE* f) {
+        bool first = true;
+        fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", f);
+        for (Ring* r = SecureThreadBlocks<Ring>::first(); r; r = r->next) {
+            const unsigned long long end = r->pos.load(std::memory_order_acquire);
+            const unsigned long long begin = end > SECURE_TRACE_EVENTS ? end - SECURE_TRACE_EVENTS : 0;
+            for (unsigned long long i = begin; i < end; ++i) {
+                const Event& e = r->events[i % SECURE_TRACE_EVENTS];
+                fprintf(f, "%s\n{\"name\":\"%s\",\"cat\":\"secure_string\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+                           "\"ts\":%llu.%03llu,\"dur\":%llu.%03llu,\"args\":{\"bytes\":%llu,\"literal\":\"%016llx\"}}",
+                        first ? "" : ",", secure_kernel_name(e.kernel), e.tid,
+                        e.begin / 1000, e.begin % 1000, (e.end - e.begin) / 1000, (e.end - e.begin) % 1000,
+                        static_cast<unsigned long long>(e.bytes), e.literal);
+                first = false;
+            }
+        }
+        fputs("\n]}\n", f);
+        return !ferror(f);
+    }
+
+    static bool dump(const char* path) {
+        FILE* f = fopen(path, "w");
+        if (!f)
+            return false;
+        bool ok = dump(f);
+        return fclose(f) == 0 && ok;
+    }
+};
+#endif
+
+#if defined(SECURE_STRING_USDT)
+#include <sys/sdt.h>
+#define SECURE_USDT1(name, a) DTRACE_PROBE1(secure_string, name, a)
+#define SECURE_USDT2(name, a, b) DTRACE_PROBE2(secure_string, name, a, b)
+#define SECURE_USDT3(name, a, b, c) DTRACE_PROBE3(secure_string, name, a, b, c)
+#else
+#define SECURE_USDT1(name, a) ((void)0)
+#define SECURE_USDT2(name, a, b) ((void)0)
+#define SECURE_USDT3(name, a, b, c) ((void)0)
+#endif
+
+// Scope hook placed at the top of every decrypt path. Empty, and optimized
+// away entirely, unless an instrumentation option is enabled. literal is
+// the per-literal seed, which identifies a literal across tools; site is
+// its SecureStats site ID.
+class SecureProbe {
+#if defined(SECURE_STRING_TIMING) || defined(SECURE_STRING_TRACE) || defined(SECURE_STRING_USDT) || defined(SECURE_STRING_STATS)
+    unsigned int kernel;
+    secure_u64 bytes;
+#endif
+#if defined(SECURE_STRING_TRACE) || defined(SECURE_STRING_USDT)
+    unsigned long long literal;
+#endif
+#if defined(SECURE_STRING_TIMING) || defined(SECURE_STRING_STATS)
+    unsigned long long start;
+#endif
+#if defined(SECURE_STRING_STATS)
+    unsigned int site;
+#endif
+#if defined(SECURE_STRING_TRACE)
+    unsigned long long begin;
+#endif
+
+public:
+    SECURE_FORCEINLINE SecureProbe(unsigned int k, secure_u64 n, unsigned long long id, unsigned int s) {
+#if defined(SECURE_STRING_STATS)
+        site = s;
+#else
+        (void)s;
+#endif
+#if defined(SECURE_STRING_TIMING) || defined(SECURE_STRING_TRACE) || defined(SECURE_STRING_USDT) || defined(SECURE_STRING_STATS)
+        kernel = k;
+        bytes = n;
+#else
+        (void)k;
+        (void)n;
+#endif
+#if defined(SECURE_STRING_TRACE) || defined(SECURE_STRING_USDT)
+        literal = id;
+#else
+        (void)id;
+#endif
+        // Wipes have their own USDT probe in secure_wipe().
+        if (k != SecureKernelWipe)
+            SECURE_USDT3(decrypt_entry, k, id, n);
+#if defined(SECURE_STRING_TRACE)
+        begin = SecureTrace::now();
+#endif
+#if defined(SECURE_STRING_TIMING) || defined(SECURE_STRING_STATS)
+        start = secure_ticks();
+#endif
+    }
+
+    SECURE_FORCEINLINE ~SecureProbe() {
+#if defined(SECURE_STRING_TIMING) || defined(SECURE_STRING_STATS)
+        const unsigned long long ticks = secure_ticks() - start;
+#endif
+#if defined(SECURE_STRING_TIMING)
+        SecureTiming::record(kernel, bytes, ticks);
+#endif
+#if defined(SECURE_STRING_STATS)
+        if (kernel != SecureKernelWipe)
+            SecureStats::cost(site, ticks);
+#endif
+#if defined(SECURE_STRING_TRACE)
+        SecureTrace::record(kernel, bytes, literal, begin, SecureTrace::now());
+#endif
+#if defined(SECURE_STRING_USDT)
+        if (kernel != SecureKernelWipe)
+            SECURE_USDT3(decrypt_exit, kernel, literal, bytes);
+#endif
+    }
+
+    SecureProbe(const SecureProbe&) = delete;
+    SecureProbe& operator=(const SecureProbe&) = delete;
+};
+
+#define SECURE_PROBE(kernel, bytes, literal, site) SecureProbe secure_probe((kernel), (bytes), (literal), (site))
+
+// Zero a buffer in a way the optimizer cannot elide or turn into memset.
+template<typename CharT>
+SECURE_FORCEINLINE void secure_wipe(CharT* p, secure_u64 n) {
+    SECURE_PROBE(SecureKernelWipe, n * sizeof(CharT), 0, 0);
+    SECURE_USDT1(wipe, n * sizeof(CharT));
+    volatile CharT* v = p;
+    for (secure_u64 i = 0; i < n; ++i)
+        v[i] = CharT{};
+}
+
+#if defined(SECURE_STRING_MANIFEST)
+// One record per ENC_* site, placed in its own section so build tooling can
+// count instantiations and ciphertext bytes without running the program.
+// The layout is fixed (128 bytes, 8-byte aligned); see
+// tools/secure_manifest.cpp for the reader.
+struct SecureManifestEntry {
+    static constexpr unsigned int Magic = 0x464D5353;   // "SSMF"
+
+    unsigned int magic;
+    unsigned int line;
+    unsigned int width;             // sizeof(CharT)
+    unsigned int count;             // characters, terminator included
+    unsigned long long bytes;       // ciphertext bytes
+    char file[104];                 // tail of __FILE__
+
+    template<secure_u64 L>
+    constexpr SecureManifestEntry(const char(&f)[L], unsigned int ln, unsigned int w, unsigned int n)
+        : magic(Magic), line(ln), width(w), count(n), bytes(static_cast<unsigned long long>(w) * n), file{} {
+        const secure_u64 skip = L > sizeof(file) ? L - sizeof(file) : 0;
+        for (secure_u64 i = 0; skip + i + 1 < L; ++i)
+            file[i] = f[skip + i];
+    }
+};
+
+#if defined(__GNUC__) && !defined(__clang__) && defined(__ELF__)
+// GCC puts the statics of inline and template functions into COMDAT
+// sections of their own: section() is either dropped for them or rejected
+// next to plain statics ("section type conflict"). The record is written
+// with inline asm instead, from an uncalled member of a per-site local
+// class. That function is emitted once per instance of the enclosing
+// function and never inlined, and the "?" flag puts the record into its
+// COMDAT group, so the linker keeps exactly one record per instance.
+template<secure_u64 V>
+struct SecureManifestConstant {
+    static constexpr secure_u64 value = V;
+};
+
+// 32-bit word k of SecureManifestEntry::file for the path f, in target
+// byte order. (x86 cannot print wider immediates into the asm.)
+template<secure_u64 L>
+constexpr unsigned int secure_manifest_word(const char(&f)[L], secure_u64 k) {
+    const secure_u64 skip = L > 104 ? L - 104 : 0;
+    unsigned int w = 0;
+    for (secure_u64 b = 0; b < 4; ++b) {
+        const secure_u64 i = skip + k * 4 + b;
+        const unsigned int c = i + 1 < L ? static_cast<unsigned char>(f[i]) : 0;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        w |= c << (8 * (3 - b));
+#else
+        w |= c << (8 * b);
+#endif
+    }
+    return w;
+}
+
+#if defined(__has_attribute)
+#if __has_attribute(retain)
+// R (SHF_GNU_RETAIN) keeps the records alive under --gc-sections.
+#define SECURE_MANIFEST_FLAGS "\"aR?\""
+#endif
+#endif
+#ifndef SECURE_MANIFEST_FLAGS
+#define SECURE_MANIFEST_FLAGS "\"a?\""
+#endif
+
+// Operands are passed through a template so they are constants even at -O0.
+#define SECURE_MANIFEST_CONSTANT(v) "i"(SecureManifestConstant<(v)>::value)
+#define SECURE_MANIFEST_WORD(k) SECURE_MANIFEST_CONSTANT(secure_manifest_word(__FILE__, k))
+#define SECURE_MANIFEST(width, count) \
+    struct secure_manifest_site { \
+        __attribute__((used)) static void emit() { \
+            asm volatile(".pushsection secure_manifest," SECURE_MANIFEST_FLAGS "\n\t.balign 8\n\t" \
+                         ".long 0x464D5353, %c0, %c1, %c2\n\t.quad %c1 * %c2\n\t" \
+                         ".long %c3, %c4, %c5, %c6, %c7, %c8, %c9, %c10, %c11, %c12, %c13, %c14, %c15, %c16, %c17, %c18, %c19, %c20, %c21, %c22, %c23, %c24, %c25, %c26, %c27, %c28\n\t" \
+                         ".popsection" \
+                         : : SECURE_MANIFEST_CONSTANT(__LINE__), SECURE_MANIFEST_CONSTANT(width), \
+                             SECURE_MANIFEST_CONSTANT(count), \
+                             SECURE_MANIFEST_WORD(0), SECURE_MANIFEST_WORD(1), SECURE_MANIFEST_WORD(2), SECURE_MANIFEST_WORD(3), SECURE_MANIFEST_WORD(4), \
+                             SECURE_MANIFEST_WORD(5), SECURE_MANIFEST_WORD(6), SECURE_MANIFEST_WORD(7), SECURE_MANIFEST_WORD(8), SECURE_MANIFEST_WORD(9), \
+                             SECURE_MANIFEST_WORD(10), SECURE_MANIFEST_WORD(11), SECURE_MANIFEST_WORD(12), SECURE_MANIFEST_WORD(13), SECURE_MANIFEST_WORD(14), \
+                             SECURE_MANIFEST_WORD(15), SECURE_MANIFEST_WORD(16), SECURE_MANIFEST_WORD(17), SECURE_MANIFEST_WORD(18), SECURE_MANIFEST_WORD(19), \
+                             SECURE_MANIFEST_WORD(20), SECURE_MANIFEST_WORD(21), SECURE_MANIFEST_WORD(22), SECURE_MANIFEST_WORD(23), SECURE_MANIFEST_WORD(24), \
+                             SECURE_MANIFEST_WORD(25)); \
+        } \
+    }
+#else
+#if defined(_MSC_VER)
+#pragma section("securemf$m", read)
+#define SECURE_MANIFEST_SECTION __declspec(allocate("securemf$m"))
+#elif defined(__has_attribute)
+#if __has_attribute(retain)
+// retain keeps the records alive under --gc-sections.
+#define SECURE_MANIFEST_SECTION __attribute__((used, retain, section("secure_manifest")))
+#endif
+#endif
+#ifndef SECURE_MANIFEST_SECTION
+#define SECURE_MANIFEST_SECTION __attribute__((used, section("secure_manifest")))
+#endif
+
+#define SECURE_MANIFEST(width, count) \
+    SECURE_MANIFEST_SECTION static constexpr SecureManifestEntry secure_manifest_entry(__FILE__, __LINE__, (width), (count))
+#endif
+#else
+#define SECURE_MANIFEST(width, count)
+#endif
 
 // Compile-time Key Generator
-template<unsigned __int64 N, unsigned long long Seed, unsigned __int64 Round = 0>
+template<secure_u64 N, unsigned long long Seed, secure_u64 Round = 0>
 struct KeyGen {
 private:
     static constexpr unsigned long long mix(unsigned long long x) {
@@ -37,7 +868,7 @@ private:
         return x ^ (x >> 33);
     }
 
-    static constexpr unsigned char get_byte(unsigned __int64 index) {
+    static constexpr unsigned char get_byte(secure_u64 index) {
         constexpr unsigned long long magic = 0x3C6EF372FE94F82BULL;
         unsigned long long val = Seed ^ (index * magic);
         val = mix(val) ^ (Round * 0x0F1E2D3C4B5A6978ULL);
@@ -46,80 +877,962 @@ private:
     }
 
 public:
-    static constexpr unsigned char get(unsigned __int64 index) {
+    static constexpr unsigned char get(secure_u64 index) {
         unsigned char k = get_byte(index) ^ get_byte(N - index - 1 + Round);
         return ROL8(k ^ index ^ (Seed & 0xFF), (index + Round) % 8 + 1);
     }
 };
 
+// Bounded UTF writer used by the transcoding decrypts. Encodes code points
+// as UTF-8, UTF-16 or UTF-32 depending on the width of OutT, always leaves
+// room for the terminator and never splits a code point.
+template<typename OutT>
+struct SecureUtfWriter {
+    OutT* out;
+    secure_u64 cap;
+    secure_u64 len;
+    bool full;
+
+    SECURE_FORCEINLINE void put(unsigned int cp) {
+        OutT u[4] = {};
+        secure_u64 n = 0;
+        if constexpr (sizeof(OutT) == 1) {
+            if (cp < 0x80) {
+                u[n++] = static_cast<OutT>(cp);
+            } else if (cp < 0x800) {
+                u[n++] = static_cast<OutT>(0xC0 | (cp >> 6));
+                u[n++] = static_cast<OutT>(0x80 | (cp & 0x3F));
+            } else if (cp < 0x10000) {
+                u[n++] = static_cast<OutT>(0xE0 | (cp >> 12));
+                u[n++] = static_cast<OutT>(0x80 | ((cp >> 6) & 0x3F));
+                u[n++] = static_cast<OutT>(0x80 | (cp & 0x3F));
+            } else {
+                u[n++] = static_cast<OutT>(0xF0 | (cp >> 18));
+                u[n++] = static_cast<OutT>(0x80 | ((cp >> 12) & 0x3F));
+                u[n++] = static_cast<OutT>(0x80 | ((cp >> 6) & 0x3F));
+                u[n++] = static_cast<OutT>(0x80 | (cp & 0x3F));
+            }
+        } else if constexpr (sizeof(OutT) == 2) {
+            if (cp < 0x10000) {
+                u[n++] = static_cast<OutT>(cp);
+            } else {
+                u[n++] = static_cast<OutT>(0xD800 | ((cp - 0x10000) >> 10));
+                u[n++] = static_cast<OutT>(0xDC00 | ((cp - 0x10000) & 0x3FF));
+            }
+        } else {
+            u[n++] = static_cast<OutT>(cp);
+        }
+
+        if (full || len + n >= cap) {
+            full = true;
+            return;
+        }
+        for (secure_u64 k = 0; k < n; ++k)
+            out[len++] = u[k];
+    }
+
+    // Terminate on success; wipe what was written on failure.
+    SECURE_FORCEINLINE secure_u64 finish(bool ok) {
+        if (cap == 0)
+            return 0;
+        if (!ok) {
+            secure_wipe(out, len);
+            len = 0;
+        }
+        out[len] = OutT{};
+        return len;
+    }
+};
+
+// Unsigned integer with the same width as a character type
+template<secure_u64 W> struct SecureUnit;
+template<> struct SecureUnit<1> { using type = unsigned char; };
+template<> struct SecureUnit<2> { using type = unsigned short; };
+template<> struct SecureUnit<4> { using type = unsigned int; };
+
+// Character type of a string literal expression
+template<typename T> struct SecureCharOf;
+template<typename CharT, secure_u64 N> struct SecureCharOf<const CharT(&)[N]> { using type = CharT; };
+
+// Detects C++23 resize_and_overwrite() without pulling in <type_traits>
+template<typename T> T&& secure_declval() noexcept;
+struct SecureNoopOp {
+    template<typename P, typename S> S operator()(P, S n) const { return n; }
+};
+template<typename C, typename = void>
+struct SecureHasResizeOverwrite { static constexpr bool value = false; };
+template<typename C>
+struct SecureHasResizeOverwrite<C, decltype(secure_declval<C&>().resize_and_overwrite(0, SecureNoopOp{}), void())> {
+    static constexpr bool value = true;
+};
+
+template<typename CharT, secure_u64 N, unsigned long long Seed>
+class SecureBuffer;
+
+#if defined(SECURE_STRING_STATS)
+#define SECURE_STATS_SITE_INIT , stats_site(site)
+#else
+#define SECURE_STATS_SITE_INIT
+#endif
+
 // SecureString encrypts characters at compile-time and decrypts at runtime
-template<typename CharT, unsigned __int64 N, unsigned long long Seed>
+template<typename CharT, secure_u64 N, unsigned long long Seed>
 class SecureString {
+    friend class SecureBuffer<CharT, N, Seed>;
+    template<typename, secure_u64, unsigned long long, secure_u64, secure_u64> friend class SecureFormat;
+
 private:
     CharT encrypted[N];
+#if defined(SECURE_STRING_INTEGRITY)
+    unsigned int tag = 0;
+#endif
+#if defined(SECURE_STRING_STATS)
+    const unsigned int* stats_site;     // SecureStats slot of the owning ENC_* expansion
+#endif
+
+    // Characters are transformed byte by byte over their full width, so a
+    // string of N characters is keyed as a stream of N * sizeof(CharT) bytes.
+    // For char this is exactly the original per-character transform.
+    using Unit = typename SecureUnit<sizeof(CharT)>::type;
+    static constexpr secure_u64 W = sizeof(CharT);
+    static constexpr secure_u64 NB = N * W;
 
-    static constexpr CharT obfuscate(CharT c, unsigned __int64 i) {
-        unsigned char k1 = KeyGen<N, Seed>::get(i);
-        unsigned char k2 = KeyGen<N, Seed ^ 0xBAADF00DDEADC0DEULL>::get(N - i - 1);
-        unsigned char k3 = KeyGen<N, Seed ^ 0xFEEDBABECAFED00DULL>::get((i * i) % N);
+    static constexpr unsigned char obfuscate_byte(unsigned char c, secure_u64 i) {
+        unsigned char k1 = KeyGen<NB, Seed>::get(i);
+        unsigned char k2 = KeyGen<NB, Seed ^ 0xBAADF00DDEADC0DEULL>::get(NB - i - 1);
+        unsigned char k3 = KeyGen<NB, Seed ^ 0xFEEDBABECAFED00DULL>::get((i * i) % NB);
 
-        unsigned char tmp = static_cast<unsigned char>(c) ^ k1;
+        unsigned char tmp = c ^ k1;
         tmp = ROL8(tmp, (k2 % 7) + 1);
         tmp = ~(tmp + (k2 ^ k3));
         tmp ^= 0xA5;
         tmp = ROR8(tmp, (i + k3) % 8);
 
-        return static_cast<CharT>(tmp);
+        return tmp;
     }
 
-    static constexpr CharT deobfuscate(CharT c, unsigned __int64 i) {
-        unsigned char k1 = KeyGen<N, Seed>::get(i);
-        unsigned char k2 = KeyGen<N, Seed ^ 0xBAADF00DDEADC0DEULL>::get(N - i - 1);
-        unsigned char k3 = KeyGen<N, Seed ^ 0xFEEDBABECAFED00DULL>::get((i * i) % N);
+    static constexpr unsigned char deobfuscate_byte(unsigned char c, secure_u64 i) {
+        unsigned char k1 = KeyGen<NB, Seed>::get(i);
+        unsigned char k2 = KeyGen<NB, Seed ^ 0xBAADF00DDEADC0DEULL>::get(NB - i - 1);
+        unsigned char k3 = KeyGen<NB, Seed ^ 0xFEEDBABECAFED00DULL>::get((i * i) % NB);
 
-        unsigned char tmp = static_cast<unsigned char>(c);
+        unsigned char tmp = c;
         tmp = ROL8(tmp, (i + k3) % 8);
         tmp ^= 0xA5;
         tmp = ~(tmp) - (k2 ^ k3);
         tmp = ROR8(tmp, (k2 % 7) + 1);
         tmp ^= k1;
 
-        return static_cast<CharT>(tmp);
+        return tmp;
+    }
+
+    static constexpr CharT obfuscate(CharT c, secure_u64 i) {
+        Unit v = static_cast<Unit>(c);
+        Unit r = 0;
+        for (secure_u64 b = 0; b < W; ++b)
+            r |= static_cast<Unit>(static_cast<Unit>(obfuscate_byte(static_cast<unsigned char>(v >> (8 * b)), i * W + b)) << (8 * b));
+        return static_cast<CharT>(r);
+    }
+
+    static constexpr CharT deobfuscate(CharT c, secure_u64 i) {
+        Unit v = static_cast<Unit>(c);
+        Unit r = 0;
+        for (secure_u64 b = 0; b < W; ++b)
+            r |= static_cast<Unit>(static_cast<Unit>(deobfuscate_byte(static_cast<unsigned char>(v >> (8 * b)), i * W + b)) << (8 * b));
+        return static_cast<CharT>(r);
+    }
+
+#if defined(SECURE_STRING_INTEGRITY)
+    // The tag covers every byte of each encrypted character, low byte first.
+    // It is taken over the ciphertext, which is in the binary anyway, so it
+    // gives away nothing about the plaintext.
+    static constexpr unsigned int tag_step(unsigned int crc, CharT c) {
+        for (secure_u64 b = 0; b < W; ++b)
+            crc = secure_crc32c(crc, static_cast<unsigned char>(static_cast<Unit>(c) >> (8 * b)));
+        return crc;
     }
 
+    static SECURE_FORCEINLINE unsigned int tag_step_rt(unsigned int crc, CharT c) {
+        for (secure_u64 b = 0; b < W; ++b)
+            crc = secure_crc32c_rt(crc, static_cast<unsigned char>(static_cast<Unit>(c) >> (8 * b)));
+        return crc;
+    }
+#endif
+
 public:
-    constexpr SecureString(const CharT(&input)[N]) : encrypted{} {
-        for (unsigned __int64 i = 0; i < N; ++i)
+    // site is the SecureStats slot of the owning ENC_* expansion, if any.
+    constexpr SecureString(const CharT(&input)[N], const unsigned int* site = nullptr) : encrypted{} SECURE_STATS_SITE_INIT {
+        (void)site;
+#if defined(SECURE_STRING_INTEGRITY)
+        unsigned int crc = 0xFFFFFFFFu;
+        for (secure_u64 i = 0; i < N; ++i) {
+            encrypted[i] = obfuscate(input[i], i);
+            crc = tag_step(crc, encrypted[i]);
+        }
+        tag = ~crc;
+#else
+        for (secure_u64 i = 0; i < N; ++i)
             encrypted[i] = obfuscate(input[i], i);
+#endif
+    }
+
+    // Decrypt into out buffer (must be at least N elements). With
+    // SECURE_STRING_INTEGRITY the tag is checked in the same pass; on
+    // mismatch out is wiped and false is returned.
+    SECURE_FORCEINLINE bool decrypt(CharT* out) const {
+        SECURE_PROBE(SecureKernelDecrypt, NB, Seed, site());
+        return decrypt_from(encrypted, out);
+    }
+
+private:
+    SECURE_FORCEINLINE bool decrypt_from(const CharT* src, CharT* out) const {
+#if defined(SECURE_STRING_INTEGRITY)
+        unsigned int crc = 0xFFFFFFFFu;
+        for (secure_u64 i = 0; i < N; ++i) {
+            const CharT c = src[i];     // src may be out
+            crc = tag_step_rt(crc, c);
+            out[i] = deobfuscate(c, i);
+        }
+        if (~crc != tag) {
+            secure_wipe(out, N);
+            return false;
+        }
+#else
+        for (secure_u64 i = 0; i < N; ++i)
+            out[i] = deobfuscate(src[i], i);
+#endif
+        return true;
+    }
+
+public:
+    // Re-obfuscate a buffer filled by decrypt() in place, using the same
+    // per-index transform as the compile-time encryption.
+    SECURE_FORCEINLINE void encrypt_in_place(CharT* buf) const {
+        SECURE_PROBE(SecureKernelSeal, NB, Seed, site());
+        for (secure_u64 i = 0; i < N; ++i)
+            buf[i] = obfuscate(buf[i], i);
     }
 
-    // Decrypt into out buffer (must be at least N elements)
-    __forceinline void decrypt(CharT* out) const {
-        for (unsigned __int64 i = 0; i < N; ++i)
-            out[i] = deobfuscate(encrypted[i], i);
+    // Reverse of encrypt_in_place(). Same result and tag check as decrypt().
+    SECURE_FORCEINLINE bool decrypt_in_place(CharT* buf) const {
+        SECURE_PROBE(SecureKernelUnseal, NB, Seed, site());
+        return decrypt_from(buf, buf);
     }
 
-    constexpr unsigned __int64 size() const { return N; }
+    // Decrypt straight into UTF-16 (char16_t, or wchar_t on Windows) in the
+    // same pass, without an intermediate plaintext copy. The literal is read
+    // as UTF-8, UTF-16 or UTF-32 according to the width of CharT; ill-formed
+    // input becomes U+FFFD. At most cap units are written, terminator
+    // included, and output stops at a code point boundary. Returns the
+    // length written, or 0 (with out wiped) if the integrity check fails.
+    template<typename OutT>
+    SECURE_FORCEINLINE secure_u64 decrypt_as_utf16(OutT* out, secure_u64 cap) const {
+        static_assert(sizeof(OutT) == 2, "decrypt_as_utf16 writes 16-bit code units");
+        SECURE_PROBE(SecureKernelTranscode, NB, Seed, site());
+        SecureUtfWriter<OutT> w{ out, cap, 0, false };
+        bool ok = decode(w);
+        return w.finish(ok);
+    }
+
+    // Same as decrypt_as_utf16(), producing UTF-8. Worst case is 3 bytes per
+    // UTF-16 unit and 4 per UTF-32 unit, plus the terminator.
+    template<typename OutT>
+    SECURE_FORCEINLINE secure_u64 decrypt_as_utf8(OutT* out, secure_u64 cap) const {
+        static_assert(sizeof(OutT) == 1, "decrypt_as_utf8 writes 8-bit code units");
+        SECURE_PROBE(SecureKernelTranscode, NB, Seed, site());
+        SecureUtfWriter<OutT> w{ out, cap, 0, false };
+        bool ok = decode(w);
+        return w.finish(ok);
+    }
+
+    // Append the decrypted string (without terminator) to a contiguous
+    // container such as std::basic_string or std::vector, decrypting
+    // directly into its storage. Uses resize_and_overwrite() when the
+    // container has it, so the new tail is written exactly once. On an
+    // integrity failure the container is restored and false is returned.
+    template<typename Container>
+    SECURE_FORCEINLINE bool append_to(Container& c) const {
+        SECURE_PROBE(SecureKernelAppend, NB, Seed, site());
+        const auto old = c.size();
+        if constexpr (SecureHasResizeOverwrite<Container>::value) {
+            bool ok = true;
+            c.resize_and_overwrite(old + (N - 1), [&](CharT* p, auto n) {
+                ok = decrypt_to(p + old, N - 1);
+                return ok ? n : old;
+            });
+            return ok;
+        } else {
+            c.resize(old + (N - 1));
+            if (!decrypt_to(c.data() + old, N - 1)) {
+                c.resize(old);
+                return false;
+            }
+            return true;
+        }
+    }
+
+    // Build a string type (e.g. std::string, or a basic_string with a custom
+    // allocator) holding the decrypted text, via append_to().
+    // Usage: auto s = ENC_LIT("Hello!").to_string<std::string>();
+    template<typename String>
+    SECURE_FORCEINLINE String to_string() const {
+        String s;
+        append_to(s);
+        return s;
+    }
+
+    // Decrypt through a small stack staging buffer and hand the text to
+    // sink(const CharT* p, secure_u64 count) in chunks of at most
+    // SECURE_STRING_STAGING characters, without a per-literal static buffer.
+    // The staging buffer is wiped afterwards. With SECURE_STRING_INTEGRITY
+    // nothing is passed to sink unless the tag matches. Returns false if the
+    // check fails or sink returns false.
+    template<typename Sink>
+    SECURE_FORCEINLINE bool write_chunks(Sink&& sink) const {
+        SECURE_PROBE(SecureKernelChunks, NB, Seed, site());
+        constexpr secure_u64 S = (N - 1 < SECURE_STRING_STAGING) ? N - 1 : SECURE_STRING_STAGING;
+        CharT stage[S ? S : 1];
+        unsigned int crc = 0xFFFFFFFFu;
+#if defined(SECURE_STRING_INTEGRITY)
+        // Literals longer than one chunk are verified in a separate pass.
+        if constexpr (N - 1 > S) {
+            for (secure_u64 i = 0; i < N; ++i)
+                next(i, crc);
+            if (~crc != tag)
+                return false;
+            crc = 0xFFFFFFFFu;
+        }
+#endif
+        SECURE_STATS_RESIDENT(static_cast<long long>(sizeof(stage)));
+        bool ok = true;
+        secure_u64 fill = 0;
+        for (secure_u64 i = 0; i + 1 < N && ok; ++i) {
+            stage[fill++] = static_cast<CharT>(next(i, crc));
+            // The last chunk is held back until the terminator is decrypted.
+            if (fill == S && i + 2 < N) {
+                ok = sink(static_cast<const CharT*>(stage), fill);
+                fill = 0;
+            }
+        }
+        next(N - 1, crc);
+#if defined(SECURE_STRING_INTEGRITY)
+        if constexpr (N - 1 <= S)
+            ok = ok && ~crc == tag;
+#endif
+        if (ok && fill)
+            ok = sink(static_cast<const CharT*>(stage), fill);
+        secure_wipe(stage, S ? S : 1);
+        SECURE_STATS_RESIDENT(-static_cast<long long>(sizeof(stage)));
+        return ok;
+    }
+
+#if defined(SECURE_STRING_POSIX_IO)
+    // Write the decrypted text (without terminator) to a file descriptor.
+    bool write_to(int fd) const {
+        return write_chunks([fd](const CharT* p, secure_u64 n) {
+            return secure_write_all(fd, p, n * sizeof(CharT));
+        });
+    }
+#endif
+
+private:
+    // Decrypt all N units, storing the first count of them.
+    SECURE_FORCEINLINE bool decrypt_to(CharT* out, secure_u64 count) const {
+        unsigned int crc = 0xFFFFFFFFu;
+        for (secure_u64 i = 0; i < N; ++i) {
+            CharT c = static_cast<CharT>(next(i, crc));
+            if (i < count)
+                out[i] = c;
+        }
+#if defined(SECURE_STRING_INTEGRITY)
+        if (~crc != tag) {
+            secure_wipe(out, count);
+            return false;
+        }
+#endif
+        return true;
+    }
+
+private:
+    // Decrypt unit i and feed it to the running tag.
+    SECURE_FORCEINLINE Unit next(secure_u64 i, unsigned int& crc) const {
+        CharT c = deobfuscate(encrypted[i], i);
+#if defined(SECURE_STRING_INTEGRITY)
+        crc = tag_step_rt(crc, encrypted[i]);
+#else
+        (void)crc;
+#endif
+        return static_cast<Unit>(c);
+    }
+
+    // Decrypt every unit once, in order, and pass the code points of
+    // [0, N - 1) to sink. The terminator is decrypted only for the tag.
+    template<typename Sink>
+    SECURE_FORCEINLINE bool decode(Sink& sink) const {
+        constexpr unsigned int bad = 0xFFFD;
+        unsigned int crc = 0xFFFFFFFFu;
+        unsigned int cp = 0, min = 0;
+        secure_u64 need = 0;
+
+        for (secure_u64 i = 0; i + 1 < N; ++i) {
+            unsigned int u = next(i, crc);
+            if constexpr (W == 1) {
+                if (need) {
+                    if ((u & 0xC0) == 0x80) {
+                        cp = (cp << 6) | (u & 0x3F);
+                        if (--need == 0)
+                            sink.put((cp < min || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) ? bad : cp);
+                        continue;
+                    }
+                    sink.put(bad);
+                    need = 0;
+                }
+                if (u < 0x80) { sink.put(u); }
+                else if ((u & 0xE0) == 0xC0) { cp = u & 0x1F; need = 1; min = 0x80; }
+                else if ((u & 0xF0) == 0xE0) { cp = u & 0x0F; need = 2; min = 0x800; }
+                else if ((u & 0xF8) == 0xF0) { cp = u & 0x07; need = 3; min = 0x10000; }
+                else { sink.put(bad); }
+            } else if constexpr (W == 2) {
+                if (need) {
+                    need = 0;
+                    if (u >= 0xDC00 && u <= 0xDFFF) {
+                        sink.put(0x10000 + ((cp - 0xD800) << 10) + (u - 0xDC00));
+                        continue;
+                    }
+                    sink.put(bad);
+                }
+                if (u >= 0xD800 && u <= 0xDBFF) { cp = u; need = 1; }
+                else if (u >= 0xDC00 && u <= 0xDFFF) { sink.put(bad); }
+                else { sink.put(u); }
+            } else {
+                sink.put((u > 0x10FFFF || (u >= 0xD800 && u <= 0xDFFF)) ? bad : u);
+            }
+        }
+        if (need)
+            sink.put(bad);
+
+        next(N - 1, crc);
+#if defined(SECURE_STRING_INTEGRITY)
+        return ~crc == tag;
+#else
+        return true;
+#endif
+    }
+
+public:
+    constexpr secure_u64 size() const { return N; }
+
+    // SecureStats site of the ENC_* expansion that owns this literal (0 for
+    // literals built outside the macros).
+    SECURE_FORCEINLINE unsigned int site() const {
+#if defined(SECURE_STRING_STATS)
+        return stats_site ? *stats_site : 0;
+#else
+        return 0;
+#endif
+    }
 };
 
-// Helper macro to create an encrypted const char* string.
-// Usage: const char* secret = ENC_STR("Hello!");
-#define ENC_STR(s) ([] { \
-    static constexpr auto crypt = SecureString<char, sizeof(s), SECURE_UNIQUE_SEED>(s); \
-    static char buf[sizeof(s)] = {}; \
+// SecureBuffer keeps a long-lived plaintext copy of a SecureString that is
+// sealed (re-obfuscated in place) once it has been idle for a while, which
+// bounds how long plaintext stays resident. Ticks are caller-defined (e.g.
+// KeQueryInterruptTime, GetTickCount64, a request counter); sweep() is meant
+// to be driven from the owner's own timer, DPC or idle path, so the header
+// stays free of threads and CRT. Not synchronized: every call on a buffer,
+// including get() against another get(), needs external locking, since
+// get() records the time of use and unseals the buffer on first use.
+template<typename CharT, secure_u64 N, unsigned long long Seed>
+class SecureBuffer {
+private:
+    const SecureString<CharT, N, Seed>& crypt;
+    CharT buf[N];
+    bool sealed;
+    secure_u64 last_use;
+
+public:
+    // Starts out sealed: the buffer holds a copy of the ciphertext.
+    // constexpr so static instances are constant-initialized (no CRT).
+    constexpr SecureBuffer(const SecureString<CharT, N, Seed>& s) : crypt(s), buf{}, sealed(true), last_use(0) {
+        for (secure_u64 i = 0; i < N; ++i)
+            buf[i] = s.encrypted[i];
+    }
+
+    SecureBuffer(const SecureBuffer&) = delete;
+    SecureBuffer& operator=(const SecureBuffer&) = delete;
+
+    // Returns the plaintext, decrypting in place if the buffer was sealed.
+    // Returns nullptr, with the buffer wiped, if the integrity check of
+    // decrypt_in_place() fails; the buffer then stays sealed.
+    SECURE_FORCEINLINE const CharT* get(secure_u64 now) {
+        SECURE_STATS_HIT(crypt.site());
+        SECURE_STATS_CACHE(crypt.site(), !sealed);
+        last_use = now;
+        if (!sealed)
+            SECURE_USDT2(cache_hit, Seed, N * sizeof(CharT));
+        if (sealed) {
+            SECURE_USDT2(cache_miss, Seed, N * sizeof(CharT));
+            if (!crypt.decrypt_in_place(buf))
+                return nullptr;
+            sealed = false;
+            SECURE_STATS_RESIDENT(static_cast<long long>(sizeof(buf)));
+        }
+        return buf;
+    }
+
+    // Seal unconditionally.
+    SECURE_FORCEINLINE void seal() {
+        if (!sealed) {
+            crypt.encrypt_in_place(buf);
+            sealed = true;
+            SECURE_STATS_RESIDENT(-static_cast<long long>(sizeof(buf)));
+        }
+    }
+
+    // Seal if the buffer has not been used for at least idle ticks.
+    // Returns true if the buffer is sealed afterwards.
+    SECURE_FORCEINLINE bool sweep(secure_u64 now, secure_u64 idle) {
+        if (!sealed && now - last_use >= idle)
+            seal();
+        return sealed;
+    }
+
+    bool is_sealed() const { return sealed; }
+};
+
+#if defined(SECURE_STRING_POSIX_IO)
+// writev() until everything is out, advancing past partially written iovecs.
+inline bool secure_writev_all(int fd, struct iovec* iov, int count) {
+    while (count > 0) {
+        ssize_t w = ::writev(fd, iov, count);
+        if (w < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        while (count > 0 && static_cast<size_t>(w) >= iov->iov_len) {
+            w -= static_cast<ssize_t>(iov->iov_len);
+            ++iov;
+            --count;
+        }
+        if (count > 0) {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + w;
+            iov->iov_len -= static_cast<size_t>(w);
+        }
+    }
+    return true;
+}
+
+inline bool secure_writev_impl(int fd, struct iovec* iov, int count) {
+    return secure_writev_all(fd, iov, count);
+}
+
+// Each literal is decrypted into its own stack frame, which stays alive
+// (and is wiped afterwards) until the single writev() has completed.
+template<typename CharT, secure_u64 N, unsigned long long Seed, typename... Rest>
+inline bool secure_writev_impl(int fd, struct iovec* iov, int count, const SecureString<CharT, N, Seed>& lit, const Rest&... rest) {
+    CharT buf[N];
+    SECURE_STATS_RESIDENT(static_cast<long long>(sizeof(buf)));
+    bool ok = lit.decrypt(buf);
+    if (ok) {
+        iov[count].iov_base = buf;
+        iov[count].iov_len = (N - 1) * sizeof(CharT);
+        ok = secure_writev_impl(fd, iov, count + 1, rest...);
+    }
+    secure_wipe(buf, N);
+    SECURE_STATS_RESIDENT(-static_cast<long long>(sizeof(buf)));
+    return ok;
+}
+
+// Emit several literals with one writev() call, e.g. a protocol banner:
+//    secure_writev(fd, ENC_LIT("HTTP/1.1 200 OK\r\n"), ENC_LIT("Server: x\r\n\r\n"));
+// Meant for short literals: all of them are on the stack at once.
+template<typename... Lits>
+inline bool secure_writev(int fd, const Lits&... lits) {
+    struct iovec iov[sizeof...(Lits) + 1];
+    return secure_writev_impl(fd, iov, 0, lits...);
+}
+#endif
+
+// ------------------------------------------------------------
+// Encrypted format strings
+//
+// ENC_FMT parses a printf-style format at compile time into literal runs
+// and conversion specs. enc_format() then decrypts the literal runs straight
+// into the output while formatting, so no plaintext copy of the format is
+// ever made and nothing is parsed at runtime.
+//
+// Supported specs: %[-0+][width][.precision][hh|h|l|ll|z|j|t](d|i|u|x|X|c|s|p)
+// and %%. Precision is the minimum number of digits for integers and the
+// maximum number of characters for strings. Arguments are type-checked by
+// C++, not by the spec: only integers, enums, strings and pointers are
+// accepted, and their number must match the specs (both at compile time).
+// Length modifiers are accepted and ignored, strings and pointers always
+// print as such, and integers are printed in the base the spec asks for.
+// ------------------------------------------------------------
+
+// Called only when a format string fails to parse; being non-constexpr,
+// it turns a bad ENC_FMT literal into a compile error at the call site.
+inline void secure_format_invalid_spec() {}
+
+template<typename CharT>
+constexpr bool secure_format_is(CharT c, const char* set) {
+    for (; *set; ++set)
+        if (c == static_cast<CharT>(*set))
+            return true;
+    return false;
+}
+
+// Parse the spec starting at input[i] ('%'). Returns the index one past it.
+template<typename CharT, secure_u64 N>
+constexpr secure_u64 secure_format_parse(const CharT(&input)[N], secure_u64 i, unsigned char& flags,
+                                               unsigned int& width, unsigned int& precision, CharT& conv) {
+    flags = 0; width = 0; precision = 0; conv = 0;
+    ++i;
+    for (; i + 1 < N && secure_format_is(input[i], "-0+"); ++i)
+        flags |= input[i] == static_cast<CharT>('-') ? 1 : input[i] == static_cast<CharT>('0') ? 2 : 4;
+    for (; i + 1 < N && input[i] >= static_cast<CharT>('0') && input[i] <= static_cast<CharT>('9'); ++i)
+        width = width * 10 + static_cast<unsigned int>(input[i] - static_cast<CharT>('0'));
+    if (i + 1 < N && input[i] == static_cast<CharT>('.')) {
+        flags |= 8;
+        for (++i; i + 1 < N && input[i] >= static_cast<CharT>('0') && input[i] <= static_cast<CharT>('9'); ++i)
+            precision = precision * 10 + static_cast<unsigned int>(input[i] - static_cast<CharT>('0'));
+    }
+    for (; i + 1 < N && secure_format_is(input[i], "hlzjt"); ++i) {}
+    if (i + 1 >= N || !secure_format_is(input[i], "diuxXcsp%"))
+        secure_format_invalid_spec();
+    conv = input[i];
+    return i + 1;
+}
+
+// Number of specs in a format, or with args only those that take an
+// argument (all but %%).
+template<typename CharT, secure_u64 N>
+constexpr secure_u64 secure_format_count(const CharT(&input)[N], bool args = false) {
+    secure_u64 count = 0;
+    unsigned char flags = 0;
+    unsigned int width = 0, precision = 0;
+    CharT conv = 0;
+    for (secure_u64 i = 0; i + 1 < N;) {
+        if (input[i] == static_cast<CharT>('%')) {
+            i = secure_format_parse(input, i, flags, width, precision, conv);
+            if (!args || conv != static_cast<CharT>('%'))
+                ++count;
+        } else {
+            ++i;
+        }
+    }
+    return count;
+}
+
+struct SecureFormatSpec {
+    secure_u64 begin;     // index of '%'
+    secure_u64 end;       // one past the conversion character
+    unsigned char flags;        // 1 = left-align, 2 = zero-pad, 4 = plus sign, 8 = precision given
+    unsigned int width;
+    unsigned int precision;
+    char conv;
+};
+
+// Count is the number of specs, Specs the number of them that take an
+// argument.
+template<typename CharT, secure_u64 N, unsigned long long Seed, secure_u64 Count, secure_u64 Specs>
+class SecureFormat {
+public:
+    SecureString<CharT, N, Seed> text;
+    SecureFormatSpec specs[Count ? Count : 1];
+
+    constexpr SecureFormat(const CharT(&input)[N], const unsigned int* site = nullptr) : text(input, site), specs{} {
+        secure_u64 k = 0;
+        for (secure_u64 i = 0; i + 1 < N;) {
+            if (input[i] == static_cast<CharT>('%')) {
+                CharT conv = 0;
+                specs[k].begin = i;
+                i = secure_format_parse(input, i, specs[k].flags, specs[k].width, specs[k].precision, conv);
+                specs[k].end = i;
+                specs[k].conv = static_cast<char>(conv);
+                ++k;
+            } else {
+                ++i;
+            }
+        }
+    }
+
+    // Decrypt unit i and feed it to the running tag.
+    SECURE_FORCEINLINE CharT next(secure_u64 i, unsigned int& crc) const {
+        return static_cast<CharT>(text.next(i, crc));
+    }
+
+    SECURE_FORCEINLINE bool verify(unsigned int crc) const {
+#if defined(SECURE_STRING_INTEGRITY)
+        return ~crc == text.tag;
+#else
+        (void)crc;
+        return true;
+#endif
+    }
+};
+
+// Integer and enum types (with the type their sign is read from), without
+// <type_traits>.
+template<typename T, bool = __is_enum(T)>
+struct SecureFormatInt { static constexpr bool value = false; using type = T; };
+template<typename T>
+struct SecureFormatInt<T, true> { static constexpr bool value = true; using type = __underlying_type(T); };
+#define SECURE_FORMAT_INT(T) \
+    template<> struct SecureFormatInt<T, false> { static constexpr bool value = true; using type = T; }
+SECURE_FORMAT_INT(bool); SECURE_FORMAT_INT(char); SECURE_FORMAT_INT(signed char); SECURE_FORMAT_INT(unsigned char);
+SECURE_FORMAT_INT(wchar_t); SECURE_FORMAT_INT(char16_t); SECURE_FORMAT_INT(char32_t);
+SECURE_FORMAT_INT(short); SECURE_FORMAT_INT(unsigned short); SECURE_FORMAT_INT(int); SECURE_FORMAT_INT(unsigned int);
+SECURE_FORMAT_INT(long); SECURE_FORMAT_INT(unsigned long); SECURE_FORMAT_INT(long long); SECURE_FORMAT_INT(unsigned long long);
+#if defined(__cpp_char8_t)
+SECURE_FORMAT_INT(char8_t);
+#endif
+#undef SECURE_FORMAT_INT
+
+// A formatting argument with its type erased to one of four kinds.
+template<typename CharT>
+struct SecureFormatArg {
+    enum Kind { Signed, Unsigned, String, Pointer } kind;
+    unsigned long long value;
+    const CharT* str;
+    secure_u64 bytes;
+
+    SecureFormatArg(const CharT* s) : kind(String), value(0), str(s), bytes(0) {}
+    SecureFormatArg(CharT* s) : kind(String), value(0), str(s), bytes(0) {}
+
+    template<typename T>
+    SecureFormatArg(T* p) : kind(Pointer), value(reinterpret_cast<unsigned long long>(p)), str(nullptr), bytes(sizeof(p)) {}
+
+    template<typename T, typename U = typename SecureFormatInt<T>::type>
+    SecureFormatArg(T v) : kind(U(-1) < U(0) ? Signed : Unsigned), value(static_cast<unsigned long long>(v)), str(nullptr), bytes(sizeof(T)) {
+        static_assert(SecureFormatInt<T>::value, "ENC_FMT arguments must be integers, enums, strings or pointers");
+    }
+};
+
+template<typename CharT>
+struct SecureFormatOut {
+    CharT* out;
+    secure_u64 cap;
+    secure_u64 len;
+
+    SECURE_FORCEINLINE void put(CharT c) {
+        if (len + 1 < cap)
+            out[len++] = c;
+    }
+
+    SECURE_FORCEINLINE void pad(secure_u64 n, CharT c) {
+        for (; n; --n)
+            put(c);
+    }
+};
+
+template<typename CharT>
+inline void secure_format_emit(SecureFormatOut<CharT>& o, const SecureFormatSpec& sp, const SecureFormatArg<CharT>* a) {
+    if (sp.conv == '%') {
+        o.put(static_cast<CharT>('%'));
+        return;
+    }
+
+    const bool left = (sp.flags & 1) != 0;
+    const bool precise = (sp.flags & 8) != 0;
+    CharT digits[24] = {};
+    const CharT* body = digits;
+    secure_u64 len = 0;
+    secure_u64 zeros = 0;       // leading zeros from the precision
+    CharT sign = 0;
+    bool numeric = true;
+
+    if (a->kind == SecureFormatArg<CharT>::String) {
+        body = a->str ? a->str : digits;
+        while (body[len] && (!precise || len < sp.precision))
+            ++len;
+        numeric = false;
+    } else if (sp.conv == 'c' && a->kind != SecureFormatArg<CharT>::Pointer) {
+        digits[0] = static_cast<CharT>(a->value);
+        len = 1;
+        numeric = false;
+    } else {
+        unsigned long long v = a->value;
+        unsigned int base = 10;
+        const char* alphabet = "0123456789abcdef";
+        if (a->kind == SecureFormatArg<CharT>::Pointer || sp.conv == 'x' || sp.conv == 'X' || sp.conv == 'p') {
+            base = 16;
+            if (sp.conv == 'X')
+                alphabet = "0123456789ABCDEF";
+        }
+        const bool pointer = a->kind == SecureFormatArg<CharT>::Pointer;
+        const bool decimal = base == 10 && sp.conv != 'u';
+        if (a->kind == SecureFormatArg<CharT>::Signed && decimal && static_cast<long long>(v) < 0) {
+            sign = static_cast<CharT>('-');
+            v = 0ULL - v;
+        } else {
+            if (a->bytes < sizeof(v))
+                v &= (1ULL << (a->bytes * 8)) - 1;
+            if (a->kind == SecureFormatArg<CharT>::Signed && decimal && (sp.flags & 4))
+                sign = static_cast<CharT>('+');
+        }
+
+        CharT rev[24] = {};
+        secure_u64 n = 0;
+        // As in printf, a zero precision prints no digits for zero.
+        if (v || pointer || !precise || sp.precision) {
+            do {
+                rev[n++] = static_cast<CharT>(alphabet[v % base]);
+                v /= base;
+            } while (v);
+        }
+        if (pointer) {
+            rev[n++] = static_cast<CharT>('x');
+            rev[n++] = static_cast<CharT>('0');
+        } else if (precise && sp.precision > n) {
+            zeros = sp.precision - n;
+        }
+        for (; len < n; ++len)
+            digits[len] = rev[n - len - 1];
+    }
+
+    const secure_u64 total = len + zeros + (sign ? 1 : 0);
+    const secure_u64 fill = sp.width > total ? sp.width - total : 0;
+    // The 0 flag is ignored with a precision, as in printf.
+    const bool zero = numeric && !left && !precise && (sp.flags & 2) != 0;
+
+    if (!left && !zero)
+        o.pad(fill, static_cast<CharT>(' '));
+    if (sign)
+        o.put(sign);
+    if (zero)
+        o.pad(fill, static_cast<CharT>('0'));
+    o.pad(zeros, static_cast<CharT>('0'));
+    for (secure_u64 k = 0; k < len; ++k)
+        o.put(body[k]);
+    if (left)
+        o.pad(fill, static_cast<CharT>(' '));
+}
+
+// Format into out (cap units, terminator included). Output is truncated
+// to fit and always terminated. Returns the number of units written, or 0
+// (with out wiped) if the integrity check of the format string fails.
+// Usage: enc_format(buf, sizeof(buf), ENC_FMT("pid=%u name=%s"), pid, name);
+template<typename CharT, secure_u64 N, unsigned long long Seed, secure_u64 Count, secure_u64 Specs, typename... Args>
+secure_u64 enc_format(CharT* out, secure_u64 cap, const SecureFormat<CharT, N, Seed, Count, Specs>& fmt, const Args&... args) {
+    static_assert(sizeof...(Args) == Specs, "enc_format: the number of arguments does not match the ENC_FMT specs");
+    SECURE_PROBE(SecureKernelFormat, N * sizeof(CharT), Seed, fmt.text.site());
+    const SecureFormatArg<CharT> list[sizeof...(Args) + 1] = { SecureFormatArg<CharT>(args)..., SecureFormatArg<CharT>(0) };
+    SecureFormatOut<CharT> o{ out, cap, 0 };
+    unsigned int crc = 0xFFFFFFFFu;
+    secure_u64 k = 0, a = 0;
+
+    for (secure_u64 i = 0; i + 1 < N; ++i) {
+        CharT c = fmt.next(i, crc);
+        if (k < Count && i >= fmt.specs[k].begin) {
+            if (i + 1 == fmt.specs[k].end) {
+                secure_format_emit(o, fmt.specs[k], fmt.specs[k].conv != '%' ? &list[a++] : nullptr);
+                ++k;
+            }
+            continue;
+        }
+        o.put(c);
+    }
+    fmt.next(N - 1, crc);
+
+    if (cap == 0)
+        return 0;
+    if (!fmt.verify(crc)) {
+        secure_wipe(out, o.len);
+        o.len = 0;
+    }
+    out[o.len] = CharT{};
+    return o.len;
+}
+
+template<typename CharT, secure_u64 Cap, secure_u64 N, unsigned long long Seed, secure_u64 Count, secure_u64 Specs, typename... Args>
+secure_u64 enc_format(CharT(&out)[Cap], const SecureFormat<CharT, N, Seed, Count, Specs>& fmt, const Args&... args) {
+    return enc_format(static_cast<CharT*>(out), Cap, fmt, args...);
+}
+
+// Shared body of the ENC_* macros: a per-site constexpr SecureString plus
+// the static buffer it decrypts into.
+#define SECURE_ENC_IMPL(CharT, s) ([] { \
+    SECURE_STATS_SLOT; \
+    static constexpr auto crypt = SecureString<CharT, sizeof(s) / sizeof(CharT), SECURE_UNIQUE_SEED>(s, SECURE_STATS_SLOT_PTR); \
+    static CharT buf[sizeof(s) / sizeof(CharT)] = {}; \
+    SECURE_MANIFEST(sizeof(CharT), sizeof(s) / sizeof(CharT)); \
+    SECURE_STATS_SITE(crypt); \
+    SECURE_STATS_RESERVE(sizeof(buf), true); \
+    SECURE_STATS_HIT(secure_site); \
     crypt.decrypt(buf); \
     return buf; \
 }())
 
+// Shared body of the ENC_*BUF macros.
+#define SECURE_BUF_IMPL(CharT, s) ([]() -> auto& { \
+    SECURE_STATS_SLOT; \
+    static constexpr auto crypt = SecureString<CharT, sizeof(s) / sizeof(CharT), SECURE_UNIQUE_SEED>(s, SECURE_STATS_SLOT_PTR); \
+    SECURE_MANIFEST(sizeof(CharT), sizeof(s) / sizeof(CharT)); \
+    SECURE_STATS_SITE(crypt); \
+    SECURE_STATS_RESERVE(sizeof(s), false); \
+    static SecureBuffer buf(crypt); \
+    return buf; \
+}())
+
+// Helper macro to create an encrypted const char* string.
+// Usage: const char* secret = ENC_STR("Hello!");
+#define ENC_STR(s) SECURE_ENC_IMPL(char, s)
+
 // Helper macro to create an encrypted const wchar_t* string.
 // Usage: const wchar_t* secret = ENC_WSTR(L"Hello!");
-#define ENC_WSTR(s) ([] { \
-    static constexpr auto crypt = SecureString<wchar_t, sizeof(s) / sizeof(wchar_t), SECURE_UNIQUE_SEED>(s); \
-    static wchar_t buf[sizeof(s) / sizeof(wchar_t)] = {}; \
-    crypt.decrypt(buf); \
-    return buf; \
+#define ENC_WSTR(s) SECURE_ENC_IMPL(wchar_t, s)
+
+// Helper macro for u8"" literals (char8_t in C++20, char before).
+// Usage: auto secret = ENC_U8STR(u8"Hello!");
+#if defined(__cpp_char8_t)
+#define ENC_U8STR(s) SECURE_ENC_IMPL(char8_t, s)
+#else
+#define ENC_U8STR(s) SECURE_ENC_IMPL(char, s)
+#endif
+
+// Helper macro to create an encrypted const char16_t* string.
+// Usage: const char16_t* secret = ENC_U16STR(u"Hello!");
+#define ENC_U16STR(s) SECURE_ENC_IMPL(char16_t, s)
+
+// Helper macro to create an encrypted const char32_t* string.
+// Usage: const char32_t* secret = ENC_U32STR(U"Hello!");
+#define ENC_U32STR(s) SECURE_ENC_IMPL(char32_t, s)
+
+// Helper macro to get the SecureString object itself, for the member API
+// (transcoding, in-place decrypt, ...). The character type is deduced.
+// Usage: char16_t w[64]; ENC_LIT("Hello!").decrypt_as_utf16(w, 64);
+#define ENC_LIT(s) ([]() -> const auto& { \
+    SECURE_STATS_SLOT; \
+    static constexpr auto crypt = SecureString<typename SecureCharOf<decltype(s)>::type, sizeof(s) / sizeof(s[0]), SECURE_UNIQUE_SEED>(s, SECURE_STATS_SLOT_PTR); \
+    SECURE_MANIFEST(sizeof(s[0]), sizeof(s) / sizeof(s[0])); \
+    SECURE_STATS_SITE(crypt); \
+    SECURE_STATS_HIT(secure_site); \
+    return crypt; \
 }())
 
+// Helper macro to create an encrypted format string for enc_format().
+// Usage: char line[128]; enc_format(line, ENC_FMT("user %s logged in (%d)"), name, id);
+#define ENC_FMT(s) ([]() -> const auto& { \
+    SECURE_STATS_SLOT; \
+    static constexpr auto fmt = SecureFormat<typename SecureCharOf<decltype(s)>::type, sizeof(s) / sizeof(s[0]), SECURE_UNIQUE_SEED, secure_format_count(s), secure_format_count(s, true)>(s, SECURE_STATS_SLOT_PTR); \
+    SECURE_MANIFEST(sizeof(s[0]), sizeof(s) / sizeof(s[0])); \
+    SECURE_STATS_SITE(fmt.text); \
+    SECURE_STATS_HIT(secure_site); \
+    return fmt; \
+}())
+
+// Helper macro to get a static SecureBuffer for a char literal. Every
+// expansion is a distinct buffer, so keep the reference:
+//    auto& b = ENC_BUF("Hello!");
+//    const char* p = b.get(now);
+//    ...
+//    b.sweep(now, idle);   // from the owner's timer
+#define ENC_BUF(s) SECURE_BUF_IMPL(char, s)
+
+// Helper macro to get a static SecureBuffer for a wchar_t literal.
+#define ENC_WBUF(s) SECURE_BUF_IMPL(wchar_t, s)
+
 /*
 MIT License
 
@@ -0,0 +1,543 @@
+// Feature tests
+// Author: oxunem (https://github.com/oxunem)
+// License: MIT
+//
+// Table-driven checks of the optional features, built with
+// SECURE_STRING_INTEGRITY, SECURE_STRING_POSIX_IO, SECURE_STRING_STATS and
+// SECURE_STRING_TIMING:
+//
+//    enc_format       every row against snprintf with the same format, at
+//                     several output sizes, plus the cases snprintf has no
+//                     equivalent for and the wipe on an integrity failure
+//    SecureBuffer     get / sweep / seal sequences, hits and misses, and
+//                     get() on a tampered literal
+//    write_to         write_to() and secure_writev() against a mock fd that
+//                     takes a few bytes per call, fails with EINTR and fails
+//                     for good after a given number of bytes
+//    SecureTiming     bucket() / bucket_limit() and snapshot() percentiles
+//    SecureStats      snapshot(), report() and footprint()
+//
+// write() and writev() are replaced for the mock fd (kMockFd) and passed on
+// to the kernel for every other one. Exits non-zero on a mismatch.
+//
+// Build (POSIX):
+//    g++ -O2 -std=c++17 -pthread -DSECURE_STRING_INTEGRITY -DSECURE_STRING_POSIX_IO
+//        -DSECURE_STRING_STATS -DSECURE_STRING_TIMING -I.. secure_feature_tests.cpp
+
+#include "../secure_string.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <cwchar>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#if !defined(SECURE_STRING_INTEGRITY) || !defined(SECURE_STRING_POSIX_IO) || !defined(SECURE_STRING_STATS) || \
+    !defined(SECURE_STRING_TIMING)
+#error "secure_feature_tests needs INTEGRITY, POSIX_IO, STATS and TIMING"
+#endif
+
+// ---- Mock fd ------------------------------------------------------------------
+
+namespace mock {
+
+constexpr int kMockFd = 1000;
+
+std::size_t limit = 0;          // most bytes taken per call
+bool eintr = false;             // fail every other call with EINTR
+std::size_t fail_at = 0;        // fail with EIO once this many bytes are out
+std::size_t calls = 0;
+std::string out;
+
+ssize_t take(const struct iovec* iov, int count) {
+    if (eintr && calls++ % 2 == 0) {
+        errno = EINTR;
+        return -1;
+    }
+    if (out.size() >= fail_at) {
+        errno = EIO;
+        return -1;
+    }
+    std::size_t room = std::min(limit, fail_at - out.size());
+    ssize_t n = 0;
+    for (int i = 0; i < count && room; ++i) {
+        const std::size_t k = std::min(room, iov[i].iov_len);
+        out.append(static_cast<const char*>(iov[i].iov_base), k);
+        room -= k;
+        n += static_cast<ssize_t>(k);
+    }
+    return n;
+}
+
+} // namespace mock
+
+extern "C" ssize_t write(int fd, const void* p, size_t n) {
+    if (fd != mock::kMockFd)
+        return syscall(SYS_write, fd, p, n);
+    struct iovec iov = { const_cast<void*>(p), n };
+    return mock::take(&iov, 1);
+}
+
+extern "C" ssize_t writev(int fd, const struct iovec* iov, int count) {
+    if (fd != mock::kMockFd)
+        return syscall(SYS_writev, fd, iov, count);
+    return mock::take(iov, count);
+}
+
+namespace {
+
+struct Checks {
+    unsigned long long checks = 0;
+    unsigned long long failures = 0;
+
+    void check(bool ok, const char* what, const char* detail) {
+        ++checks;
+        if (!ok && failures++ < 20)
+            std::fprintf(stderr, "features: %s mismatch (%s)\n", what, detail);
+    }
+};
+
+// ---- enc_format -----------------------------------------------------------------
+
+struct FormatCase {
+    const char* format;
+    secure_u64 (*run)(char* out, secure_u64 cap);
+    int (*ref)(char* out, std::size_t cap);
+};
+
+// Each row formats the same arguments with enc_format and with snprintf.
+#define FORMAT_CASE(fmt, ...)                                                                            \
+    { fmt, [](char* o, secure_u64 cap) { return enc_format(o, cap, ENC_FMT(fmt), __VA_ARGS__); },        \
+      [](char* o, std::size_t cap) { return std::snprintf(o, cap, fmt, __VA_ARGS__); } }
+
+const FormatCase kFormatCases[] = {
+    FORMAT_CASE("%d|%i|%u", -42, 17, 42u),
+    FORMAT_CASE("[%5d][%-5d][%05d][%1d]", 42, 42, -42, 12345),
+    FORMAT_CASE("[%+d][%+d][%+5d][%-+5d][%+05d]", 5, -5, 0, 7, 7),
+    FORMAT_CASE("[%.3d][%6.3d][%-6.3d][%.0d][%.0d]", 7, -7, 7, 0, 3),
+    FORMAT_CASE("[%.2s][%-6.3s][%6s][%.0s][%.9s]", "abcdef", "abcdef", "ab", "xyz", "short"),
+    FORMAT_CASE("%x %X %08x %.6x %4x", 0xbeefu, 0xbeefu, 0xbeu, 0xbeu, 0x12345u),
+    FORMAT_CASE("%x %u", -1, -1),
+    FORMAT_CASE("%hhd %hu %ld %lld %zu", static_cast<signed char>(-5), static_cast<unsigned short>(65535), -123456789L,
+                -1LL, static_cast<std::size_t>(123)),
+    FORMAT_CASE("%d %lld %llu", INT_MIN, LLONG_MIN, ULLONG_MAX),
+    FORMAT_CASE("%c%c%-3c|%3c", 'a', 'b', 'c', 'd'),
+    FORMAT_CASE("%p|%20p|%-20p|", reinterpret_cast<void*>(0x1234), reinterpret_cast<void*>(0xdeadbeef),
+                reinterpret_cast<void*>(0xdeadbeef)),
+    FORMAT_CASE("100%% %s%%", "done"),
+    FORMAT_CASE("%s=%d (0x%04x)", "id", -42, 0xbeefu),
+    FORMAT_CASE("a literal run that is longer than the output buffer %s", "and an argument"),
+};
+
+enum Colour : int { kRed = 3 };
+enum class Level : short { kLow = -2 };
+
+struct FormatExpect {
+    const char* expect;
+    secure_u64 (*run)(char* out, secure_u64 cap);
+};
+
+// Arguments snprintf cannot take, or prints differently (a null string is
+// empty here), and the 0 flag with a precision, which -Wformat rejects.
+const FormatExpect kFormatExpect[] = {
+    { "[   03][-03  ]", [](char* o, secure_u64 cap) { return enc_format(o, cap, ENC_FMT("[%05.2d][%-05.2d]"), 3, -3); } },
+    { "3|-2|+3", [](char* o, secure_u64 cap) { return enc_format(o, cap, ENC_FMT("%d|%d|%+d"), kRed, Level::kLow, kRed); } },
+    { "|   -", [](char* o, secure_u64 cap) {
+          return enc_format(o, cap, ENC_FMT("%s|%4s"), static_cast<const char*>(nullptr), "-");
+      } },
+};
+
+void check_format(Checks& c) {
+    const secure_u64 caps[] = { 0, 1, 2, 5, 16, 64, 128 };
+    for (const FormatCase& f : kFormatCases) {
+        char expect[128];
+        const std::size_t full = static_cast<std::size_t>(f.ref(expect, sizeof(expect)));
+        for (secure_u64 cap : caps) {
+            char out[128];
+            std::memset(out, 'x', sizeof(out));
+            const secure_u64 n = f.run(out, cap);
+            bool ok;
+            if (cap == 0) {
+                ok = n == 0 && out[0] == 'x';
+            } else {
+                f.ref(expect, cap);
+                const secure_u64 len = std::min<secure_u64>(full, cap - 1);
+                ok = n == len && std::memcmp(out, expect, len + 1) == 0 && (cap == sizeof(out) || out[cap] == 'x');
+            }
+            c.check(ok, "enc_format", f.format);
+        }
+    }
+
+    for (const FormatExpect& f : kFormatExpect) {
+        char out[64];
+        const secure_u64 n = f.run(out, sizeof(out));
+        c.check(n == std::strlen(f.expect) && std::strcmp(out, f.expect) == 0, "enc_format", f.expect);
+    }
+
+    wchar_t wide[32];
+    const secure_u64 n = enc_format(wide, ENC_FMT(L"[%-4s|%3d|%x]"), L"ab", -7, 255);
+    c.check(n == 13 && std::wcscmp(wide, L"[ab  | -7|ff]") == 0, "enc_format", "wchar_t");
+
+    // A tampered format string leaves nothing behind: the 14 characters
+    // written are wiped. text.encrypted[] is the first member of the format.
+    SecureFormat<char, sizeof("tampered %d"), 0x5EC0DE, 1, 1> fmt("tampered %d");
+    reinterpret_cast<unsigned char*>(&fmt)[2] ^= 0x10;
+    char out[32];
+    std::memset(out, 'x', sizeof(out));
+    const bool wiped = enc_format(out, fmt, 12345) == 0 &&
+                       std::all_of(out, out + 14, [](char ch) { return ch == 0; });
+    c.check(wiped, "enc_format", "integrity failure");
+}
+
+// ---- SecureBuffer ---------------------------------------------------------------
+
+SecureSiteStats find_site(unsigned int line) {
+    std::vector<SecureSiteStats> st(SECURE_STATS_MAX_SITES);
+    const unsigned int n = SecureStats::snapshot(st.data(), SECURE_STATS_MAX_SITES);
+    for (unsigned int i = 0; i < n; ++i)
+        if (st[i].line == line && std::strstr(st[i].file, "secure_feature_tests.cpp"))
+            return st[i];
+    return {};
+}
+
+constexpr char kBufferText[] = "sealed when idle";
+constexpr unsigned int kBufferLine = __LINE__ + 1;
+auto& buffer_site() { return ENC_BUF("sealed when idle"); }
+
+struct BufferStep {
+    char op;                    // 'g'et, s'w'eep or 's'eal
+    secure_u64 now;
+    secure_u64 idle;
+    bool sealed;                // expected afterwards
+};
+
+const BufferStep kBufferSteps[] = {
+    { 'g', 10, 0, false },      // miss
+    { 'w', 15, 10, false },     // idle 5 < 10
+    { 'g', 18, 0, false },      // hit
+    { 'w', 27, 10, false },     // idle 9
+    { 'w', 28, 10, true },      // idle 10: sealed
+    { 'w', 99, 10, true },      // already sealed
+    { 's', 99, 0, true },       // seal() on a sealed buffer is a no-op
+    { 'g', 100, 0, false },     // miss
+    { 'g', 100, 0, false },     // hit
+    { 's', 100, 0, true },
+    { 'w', 200, 0, true },
+    { 'g', 300, 0, false },     // miss
+    { 'w', 300, 0, true },      // idle 0 seals right away
+};
+
+void check_buffer(Checks& c) {
+    auto& b = buffer_site();
+    const SecureSiteStats before = find_site(kBufferLine);
+    const unsigned long long resident = SecureStats::footprint().resident;
+    unsigned long long hits = 0, misses = 0;
+    const char* p = nullptr;
+    char step[32];
+
+    c.check(b.is_sealed(), "SecureBuffer", "starts sealed");
+    for (const BufferStep& s : kBufferSteps) {
+        std::snprintf(step, sizeof(step), "%c at %llu", s.op, static_cast<unsigned long long>(s.now));
+        bool ok = true;
+        if (s.op == 'g') {
+            ++(b.is_sealed() ? misses : hits);
+            p = b.get(s.now);
+            ok = p && std::strcmp(p, kBufferText) == 0;
+        } else if (s.op == 'w') {
+            ok = b.sweep(s.now, s.idle) == s.sealed;
+        } else {
+            b.seal();
+        }
+        // A sealed buffer holds ciphertext and is not resident.
+        const unsigned long long now = SecureStats::footprint().resident;
+        ok = ok && b.is_sealed() == s.sealed && now == resident + (s.sealed ? 0 : sizeof(kBufferText));
+        if (s.sealed && p)
+            ok = ok && std::memcmp(p, kBufferText, sizeof(kBufferText)) != 0;
+        c.check(ok, "SecureBuffer", step);
+    }
+
+    const SecureSiteStats after = find_site(kBufferLine);
+    c.check(after.hits - before.hits == hits && after.misses - before.misses == misses && after.calls - before.calls == hits + misses,
+            "SecureBuffer", "hits and misses");
+
+    // A tampered literal: get() fails, the buffer stays sealed and nothing
+    // is counted as resident. encrypted[] is the first member.
+    SecureString<char, sizeof("tampered"), 0x5EC0DE> lit("tampered");
+    reinterpret_cast<unsigned char*>(&lit)[3] ^= 0x10;
+    SecureBuffer<char, sizeof("tampered"), 0x5EC0DE> tampered(lit);
+    const unsigned long long before_get = SecureStats::footprint().resident;
+    c.check(tampered.get(1) == nullptr && tampered.is_sealed() && SecureStats::footprint().resident == before_get,
+            "SecureBuffer", "integrity failure");
+}
+
+// ---- write_to / secure_writev -------------------------------------------------
+
+#define LONG_TEXT                                                                               \
+    "0123456789abcdefghijklmnopqrstuvwxyz0123456789abcdefghijklmnopqrstuvwxyz0123456789abcdef\n" \
+    "0123456789abcdefghijklmnopqrstuvwxyz0123456789abcdefghijklmnopqrstuvwxyz0123456789abcdef\n" \
+    "0123456789abcdefghijklmnopqrstuvwxyz0123456789abcdefghijklmnopqrstuvwxyz0123456789abcdef\n" \
+    "0123456789abcdefghijklmnopqrstuvwxyz0123456789abcdefghijklmnopqrstuvwxyz0123456789abcdef\n" \
+    "0123456789abcdefghijklmnopqrstuvwxyz0123456789abcdefghijklmnopqrstuvwxyz0123456789abcdef\n" \
+    "0123456789abcdefghijklmnopqrstuvwxyz0123456789abcdefghijklmnopqrstuvwxyz0123456789abcdef\n" \
+    "0123456789abcdefghijklmnopqrstuvwxyz0123456789abcdefghijklmnopqrstuvwxyz0123456789abcdef\n"
+
+struct WriteCase {
+    const char* name;
+    std::string expect;
+    bool (*run)();
+};
+
+struct MockConfig {
+    std::size_t limit;
+    bool eintr;
+    std::size_t fail_at;
+};
+
+const MockConfig kMockConfigs[] = {
+    { 1 << 20, false, ~std::size_t(0) },
+    { 1, false, ~std::size_t(0) },
+    { 3, false, ~std::size_t(0) },
+    { 7, true, ~std::size_t(0) },
+    { 64, true, ~std::size_t(0) },
+    { 5, false, 17 },
+    { 1 << 20, true, 300 },
+    { 1 << 20, false, 0 },
+};
+
+void check_write(Checks& c) {
+    static_assert(sizeof(LONG_TEXT) > 2 * SECURE_STRING_STAGING, "the long text must span several chunks");
+    const WriteCase cases[] = {
+        { "write_to", "short line\n", [] { return ENC_LIT("short line\n").write_to(mock::kMockFd); } },
+        { "write_to long", LONG_TEXT, [] { return ENC_LIT(LONG_TEXT).write_to(mock::kMockFd); } },
+        { "secure_writev", "HTTP/1.1 200 OK\r\nServer: x\r\n\r\n", [] {
+              return secure_writev(mock::kMockFd, ENC_LIT("HTTP/1.1 200 OK\r\n"), ENC_LIT("Server: x\r\n"), ENC_LIT("\r\n"));
+          } },
+        { "secure_writev long", std::string("head\n") + LONG_TEXT, [] {
+              return secure_writev(mock::kMockFd, ENC_LIT("head\n"), ENC_LIT(LONG_TEXT));
+          } },
+    };
+
+    for (const MockConfig& m : kMockConfigs) {
+        for (const WriteCase& w : cases) {
+            mock::limit = m.limit;
+            mock::eintr = m.eintr;
+            mock::fail_at = m.fail_at;
+            mock::calls = 0;
+            mock::out.clear();
+            const bool ok = w.run();
+            const bool complete = m.fail_at >= w.expect.size();
+            char detail[96];
+            std::snprintf(detail, sizeof(detail), "%s, %zu per call%s, fail at %zu", w.name, m.limit, m.eintr ? ", EINTR" : "",
+                          m.fail_at);
+            c.check(ok == complete && mock::out == w.expect.substr(0, std::min(m.fail_at, w.expect.size())), "write", detail);
+        }
+    }
+}
+
+// ---- SecureTiming ---------------------------------------------------------------
+
+struct BucketCase {
+    unsigned long long value;
+    unsigned int bucket;
+    unsigned long long limit;
+};
+
+const BucketCase kBucketCases[] = {
+    { 0, 0, 0 },
+    { 7, 7, 7 },
+    { 8, 8, 8 },
+    { 15, 15, 15 },
+    { 16, 16, 17 },
+    { 17, 16, 17 },
+    { 18, 17, 19 },
+    { 50, 28, 51 },
+    { 1000, 63, 1023 },
+    { 1ULL << 39, 296, (9ULL << 36) - 1 },
+    { 1ULL << 40, SecureTiming::Buckets - 1, (16ULL << 36) - 1 },
+    { ~0ULL, SecureTiming::Buckets - 1, (16ULL << 36) - 1 },
+};
+
+struct PercentileCase {
+    std::vector<unsigned long long> values;
+    bool threaded;              // record half of the values from a second thread
+    SecureLatency expect;
+};
+
+void check_timing(Checks& c) {
+    char detail[64];
+    for (const BucketCase& b : kBucketCases) {
+        std::snprintf(detail, sizeof(detail), "%llu", b.value);
+        c.check(SecureTiming::bucket(b.value) == b.bucket && SecureTiming::bucket_limit(b.bucket) == b.limit, "bucket", detail);
+    }
+
+    // Every value lies in its bucket, above the previous one, and at most
+    // 1/8 below the limit.
+    std::mt19937_64 rng(1);
+    for (int i = 0; i < 100000; ++i) {
+        const unsigned long long v = i < 5000 ? i : rng() >> (rng() % 64);
+        if (v >= (1ULL << SecureTiming::MaxBits))
+            continue;
+        const unsigned int b = SecureTiming::bucket(v);
+        const unsigned long long limit = SecureTiming::bucket_limit(b);
+        const bool ok = limit >= v && (b == 0 || SecureTiming::bucket_limit(b - 1) < v) && limit - v <= v / 8;
+        if (!ok) {
+            std::snprintf(detail, sizeof(detail), "bucket of %llu", v);
+            c.check(false, "bucket", detail);
+        }
+    }
+
+    std::vector<unsigned long long> uniform(100), skewed(1000, 10), spread;
+    for (unsigned long long i = 0; i < 100; ++i)
+        uniform[i] = i + 1;
+    skewed.back() = 100000;
+    for (int i = 0; i < 10000; ++i)
+        spread.push_back(rng() % 1000000);
+    const PercentileCase cases[] = {
+        { { 5 }, false, { 1, 5, 5, 5, 5, 5 } },
+        { uniform, false, { 100, 51, 95, 103, 103, 103 } },
+        { uniform, true, { 100, 51, 95, 103, 103, 103 } },
+        { skewed, false, { 1000, 10, 10, 10, 10, SecureTiming::bucket_limit(SecureTiming::bucket(100000)) } },
+        { spread, true, {} },
+    };
+
+    // Each case records into a length class of its own; nothing else in
+    // this program decrypts 4 KiB or more.
+    unsigned int length_class = 12;
+    for (const PercentileCase& p : cases) {
+        const secure_u64 bytes = secure_u64(1) << length_class;
+        const std::size_t half = p.threaded ? p.values.size() / 2 : p.values.size();
+        for (std::size_t i = 0; i < half; ++i)
+            SecureTiming::record(SecureKernelFormat, bytes, p.values[i]);
+        std::thread([&] {
+            for (std::size_t i = half; i < p.values.size(); ++i)
+                SecureTiming::record(SecureKernelFormat, bytes, p.values[i]);
+        }).join();
+
+        // The expected values: the bucket limit of the value at rank
+        // ceil(count * q), as in snapshot().
+        SecureLatency expect = p.expect;
+        if (!expect.count) {
+            std::vector<unsigned long long> sorted(p.values);
+            std::sort(sorted.begin(), sorted.end());
+            const auto at = [&](unsigned long long q) {
+                return SecureTiming::bucket_limit(SecureTiming::bucket(sorted[(sorted.size() * q + 999) / 1000 - 1]));
+            };
+            expect = { sorted.size(), at(500), at(900), at(990), at(999), at(1000) };
+        }
+
+        SecureLatency got;
+        const bool recorded = SecureTiming::snapshot(SecureKernelFormat, length_class, got);
+        std::snprintf(detail, sizeof(detail), "%zu values%s", p.values.size(), p.threaded ? ", two threads" : "");
+        c.check(recorded && got.count == expect.count && got.p50 == expect.p50 && got.p90 == expect.p90 && got.p99 == expect.p99 &&
+                    got.p999 == expect.p999 && got.max == expect.max,
+                "percentiles", detail);
+        ++length_class;
+    }
+
+    SecureLatency none;
+    c.check(!SecureTiming::snapshot(SecureKernelAppend, SecureTiming::Classes - 1, none) && none.count == 0, "percentiles", "empty");
+    c.check(!SecureTiming::snapshot(SecureKernelCount, 0, none), "percentiles", "bad kernel");
+}
+
+// ---- SecureStats ----------------------------------------------------------------
+
+constexpr char kStatsText[] = "counted site";
+constexpr unsigned int kStatsLine = __LINE__ + 1;
+const char* stats_site() { return ENC_STR("counted site"); }
+
+constexpr char kStatsBufText[] = "counted buffer";
+auto& stats_buffer() { return ENC_BUF("counted buffer"); }
+
+struct FootprintStep {
+    const char* name;
+    void (*run)();
+    long long resident;         // change of resident bytes
+    unsigned long long executed;    // change of static storage of executed sites
+};
+
+const FootprintStep kFootprintSteps[] = {
+    { "ENC_STR first use", [] { stats_site(); }, sizeof(kStatsText), sizeof(kStatsText) },
+    { "ENC_STR again", [] { stats_site(); }, 0, 0 },
+    { "ENC_BUF first use", [] { stats_buffer(); }, 0, sizeof(kStatsBufText) },
+    { "ENC_BUF get", [] { stats_buffer().get(1); }, sizeof(kStatsBufText), 0 },
+    { "ENC_BUF seal", [] { stats_buffer().seal(); }, -static_cast<long long>(sizeof(kStatsBufText)), 0 },
+    { "ENC_LIT decrypt", [] {
+          char out[16];
+          ENC_LIT("caller owned").decrypt(out);
+      }, 0, 0 },
+    { "write_chunks", [] { ENC_LIT("staged").write_chunks([](const char*, secure_u64) { return true; }); }, 0, 0 },
+};
+
+void check_stats(Checks& c) {
+    for (const FootprintStep& s : kFootprintSteps) {
+        const SecureFootprint before = SecureStats::footprint();
+        s.run();
+        const SecureFootprint after = SecureStats::footprint();
+        c.check(static_cast<long long>(after.resident - before.resident) == s.resident && after.executed - before.executed == s.executed &&
+                    after.peak >= after.resident && after.peak >= before.peak,
+                "footprint", s.name);
+    }
+
+    // The staging buffer counts while the sink runs and raises the peak.
+    const SecureFootprint idle = SecureStats::footprint();
+    unsigned long long inside = 0;
+    ENC_LIT("staged again").write_chunks([&](const char*, secure_u64) {
+        inside = SecureStats::footprint().resident;
+        return true;
+    });
+    c.check(inside == idle.resident + sizeof("staged again") - 1 && SecureStats::footprint().peak >= inside, "footprint", "staging");
+
+    // snapshot(): one entry per site, calls counted per use.
+    const SecureSiteStats before = find_site(kStatsLine);
+    for (int i = 0; i < 5; ++i)
+        stats_site();
+    const SecureSiteStats after = find_site(kStatsLine);
+    c.check(after.id != 0 && after.bytes == sizeof(kStatsText) && after.calls - before.calls == 5, "snapshot", "calls");
+    std::vector<SecureSiteStats> st(SECURE_STATS_MAX_SITES);
+    const unsigned int n = SecureStats::snapshot(st.data(), SECURE_STATS_MAX_SITES);
+    c.check(SecureStats::snapshot(st.data(), 1) == 1 && n > 1, "snapshot", "max entries");
+
+    // report(): a line for the site and the footprint at the end.
+    std::FILE* f = std::tmpfile();
+    std::string text;
+    if (f) {
+        SecureStats::report(f);
+        std::rewind(f);
+        char chunk[4096];
+        for (std::size_t k; (k = std::fread(chunk, 1, sizeof(chunk), f)) != 0;)
+            text.append(chunk, k);
+        std::fclose(f);
+    }
+    char site[64], footprint[160];
+    std::snprintf(site, sizeof(site), "secure_feature_tests.cpp:%u ", kStatsLine);
+    const SecureFootprint fp = SecureStats::footprint();
+    std::snprintf(footprint, sizeof(footprint),
+                  "plaintext resident %llu bytes, peak %llu bytes, static buffers of executed sites %llu bytes\n", fp.resident,
+                  fp.peak, fp.executed);
+    c.check(text.find(site) != std::string::npos, "report", "site line");
+    c.check(text.size() >= std::strlen(footprint) && text.compare(text.size() - std::strlen(footprint), std::string::npos, footprint) == 0,
+            "report", "footprint line");
+}
+
+} // namespace
+
+int main() {
+    Checks c;
+    check_format(c);
+    check_buffer(c);
+    check_write(c);
+    check_timing(c);
+    check_stats(c);
+    std::fprintf(stderr, "features: %llu checks, %llu failures\n", c.checks, c.failures);
+    return c.failures == 0 ? 0 : 1;
+}
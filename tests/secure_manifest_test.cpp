@@ -0,0 +1,96 @@
+// Manifest test
+// Author: oxunem (https://github.com/oxunem)
+// License: MIT
+//
+// Built with SECURE_STRING_MANIFEST. One translation unit with an ENC_*
+// site in a plain function, one in an inline function and one in a
+// function template instantiated twice. GCC gives the statics of inline
+// and template functions COMDAT sections of their own, so all three kinds
+// must still land in the one secure_manifest section, with one record per
+// instance. Reads the records back through the linker's
+// __start_/__stop_secure_manifest symbols and exits non-zero if a record
+// is missing, duplicated or wrong. ELF only.
+//
+// Build:
+//    g++ -O2 -std=c++17 -DSECURE_STRING_MANIFEST -I.. secure_manifest_test.cpp
+
+#include "../secure_string.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <cwchar>
+
+#if !defined(__ELF__)
+#error "secure_manifest_test reads the ELF section boundaries"
+#endif
+
+extern "C" const SecureManifestEntry __start_secure_manifest[];
+extern "C" const SecureManifestEntry __stop_secure_manifest[];
+
+namespace {
+
+constexpr unsigned int kPlainLine = __LINE__ + 1;
+const char* plain_site() { return ENC_STR("plain"); }
+
+constexpr unsigned int kInlineLine = __LINE__ + 1;
+inline const wchar_t* inline_site() { return ENC_WSTR(L"inline"); }
+
+constexpr unsigned int kTemplateLine = __LINE__ + 2;
+template<int K>
+const char* template_site() { return ENC_STR("template") + K; }
+
+struct Expect {
+    unsigned int line;
+    unsigned int width;
+    unsigned int count;
+    unsigned int records;
+};
+
+} // namespace
+
+int main() {
+    const char* plain = plain_site();
+    const wchar_t* wide = inline_site();
+    const char* t0 = template_site<0>();
+    const char* t1 = template_site<1>();
+    if (std::strcmp(plain, "plain") != 0 || std::wcscmp(wide, L"inline") != 0 || std::strcmp(t0, "template") != 0 ||
+        std::strcmp(t1, "emplate") != 0) {
+        std::fprintf(stderr, "manifest: decrypted text mismatch\n");
+        return 1;
+    }
+
+    Expect expect[] = {
+        { kPlainLine, 1, 6, 1 },
+        { kInlineLine, sizeof(wchar_t), 7, 1 },
+        { kTemplateLine, 1, 9, 2 },
+    };
+    unsigned int found[3] = {};
+    unsigned int failures = 0;
+    for (const SecureManifestEntry* e = __start_secure_manifest; e < __stop_secure_manifest; ++e) {
+        const char* file = std::strstr(e->file, "secure_manifest_test.cpp");
+        bool known = false;
+        for (unsigned int i = 0; i < 3; ++i) {
+            const Expect& x = expect[i];
+            if (e->magic == SecureManifestEntry::Magic && file && e->line == x.line && e->width == x.width &&
+                e->count == x.count && e->bytes == static_cast<unsigned long long>(x.width) * x.count) {
+                ++found[i];
+                known = true;
+            }
+        }
+        if (!known) {
+            std::fprintf(stderr, "manifest: unexpected record %.*s:%u (width %u, count %u)\n", 104, e->file, e->line,
+                         e->width, e->count);
+            ++failures;
+        }
+    }
+    const char* kind[] = { "plain", "inline", "template" };
+    for (unsigned int i = 0; i < 3; ++i) {
+        if (found[i] != expect[i].records) {
+            std::fprintf(stderr, "manifest: %u %s records, expected %u\n", found[i], kind[i], expect[i].records);
+            ++failures;
+        }
+    }
+    std::fprintf(stderr, "manifest: %u records, %u failures\n",
+                 static_cast<unsigned int>(__stop_secure_manifest - __start_secure_manifest), failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,251 @@
+// Differential checks shared by the tests and the fuzzer
+// Author: oxunem (https://github.com/oxunem)
+// License: MIT
+//
+// An independent re-implementation of the transform, and a check of every
+// decrypt path of one SecureString against it: encrypt_in_place(), the
+// in-place decrypt, decrypt() into every valid alignment up to 8 bytes,
+// append_to(), write_chunks(), the transcoders and, with
+// SECURE_STRING_INTEGRITY, tamper detection.
+//
+// Seeds are template arguments, so the cases are instantiated up front: a
+// table per character type of kVerifyCases (length, seed) pairs. The lengths
+// cover every length up to 34 characters (all tails of 8/16/32-byte vectors,
+// and of 64-byte ones for wide characters), 63 to 65 and 127 to 129, the
+// staging boundaries and a few long literals; every case has its own seed,
+// the all-zero and all-one seeds included. Each case costs a full set of
+// kernel instantiations, which bounds the size of the table. Callers draw
+// cases from the table at random.
+
+#pragma once
+
+#include "../secure_string.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ref {
+
+constexpr unsigned long long mix(unsigned long long x) {
+    x ^= x >> 33; x *= 0xD6E8FEB86659FD93ULL;
+    x ^= x >> 33; x *= 0xA5CB3E2C1F16F4C5ULL;
+    return x ^ (x >> 33);
+}
+
+inline unsigned char rol(unsigned long long x, unsigned r) {
+    r %= 8;
+    return static_cast<unsigned char>((x << r) | (x >> (8 - r)));
+}
+
+inline unsigned char key_byte(unsigned long long seed, unsigned long long i) {
+    unsigned long long v = mix(seed ^ (i * 0x3C6EF372FE94F82BULL));
+    v = (v >> 32) ^ (v & 0xFFFFFFFF);
+    return static_cast<unsigned char>(v ^ (v >> 16) ^ (v >> 8));
+}
+
+inline unsigned char key(std::size_t n, unsigned long long seed, unsigned long long i) {
+    const unsigned long long k = key_byte(seed, i) ^ key_byte(seed, n - i - 1);
+    return rol(k ^ i ^ (seed & 0xFF), static_cast<unsigned>(i % 8 + 1));
+}
+
+inline unsigned char encrypt_byte(unsigned char c, std::size_t n, unsigned long long seed, unsigned long long i) {
+    const unsigned k1 = key(n, seed, i);
+    const unsigned k2 = key(n, seed ^ 0xBAADF00DDEADC0DEULL, n - i - 1);
+    const unsigned k3 = key(n, seed ^ 0xFEEDBABECAFED00DULL, (i * i) % n);
+    unsigned char t = static_cast<unsigned char>(c ^ k1);
+    t = rol(t, k2 % 7 + 1);
+    t = static_cast<unsigned char>(~(t + (k2 ^ k3)));
+    t ^= 0xA5;
+    return rol(t, static_cast<unsigned>(8 - (i + k3) % 8));
+}
+
+// Ciphertext of text[0..n) as the header lays it out: each character is
+// keyed as W consecutive bytes of the stream, low byte first.
+template<typename CharT>
+std::vector<CharT> encrypt(const CharT* text, std::size_t n, unsigned long long seed) {
+    using Unit = typename SecureUnit<sizeof(CharT)>::type;
+    const std::size_t w = sizeof(CharT);
+    std::vector<CharT> out(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        const Unit v = static_cast<Unit>(text[i]);
+        Unit r = 0;
+        for (std::size_t b = 0; b < w; ++b)
+            r |= static_cast<Unit>(static_cast<Unit>(encrypt_byte(static_cast<unsigned char>(v >> (8 * b)), n * w, seed, i * w + b)) << (8 * b));
+        out[i] = static_cast<CharT>(r);
+    }
+    return out;
+}
+
+inline void put_utf8(std::vector<char>& out, unsigned long cp) {
+    if (cp < 0x80) {
+        out.push_back(static_cast<char>(cp));
+    } else if (cp < 0x800) {
+        out.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        out.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else {
+        out.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    }
+}
+
+} // namespace ref
+
+inline const char* char_name(char) { return "char"; }
+inline const char* char_name(wchar_t) { return "wchar_t"; }
+inline const char* char_name(char16_t) { return "char16_t"; }
+inline const char* char_name(char32_t) { return "char32_t"; }
+
+// A character from the random value r, never the terminator. Wide
+// characters stay clear of surrogates so every text is valid input for the
+// transcoders.
+template<typename CharT>
+CharT verify_char(unsigned long long r, bool ascii) {
+    if (ascii)
+        return static_cast<CharT>(1 + r % 0x7F);
+    if constexpr (sizeof(CharT) == 1)
+        return static_cast<CharT>(1 + r % 0xFF);
+    else if constexpr (sizeof(CharT) == 2)
+        return static_cast<CharT>(1 + r % 0xD7FF);
+    else {
+        unsigned long cp = static_cast<unsigned long>(1 + r % 0x10FFFF);
+        return static_cast<CharT>(cp >= 0xD800 && cp < 0xE000 ? cp - 0x800 : cp);
+    }
+}
+
+struct Verify {
+    std::mt19937_64 rng;
+    unsigned long long checks = 0;
+    unsigned long long failures = 0;
+
+    void check(bool ok, const char* what, const char* type, std::size_t n, unsigned long long seed) {
+        ++checks;
+        if (!ok && failures++ < 20)
+            std::fprintf(stderr, "verify: %s mismatch for %s, N=%zu, seed=%016llx\n", what, type, n, seed);
+    }
+};
+
+// Checks every path of SecureString<CharT, N, Seed> for text[0..N), whose
+// last character is the terminator and the others are not.
+template<typename CharT, std::size_t N, unsigned long long Seed>
+void verify_case(Verify& v, const CharT* text_in) {
+    using Lit = SecureString<CharT, N, Seed>;
+    const char* type = char_name(CharT());
+
+    const std::vector<CharT> text(text_in, text_in + N);
+    const Lit lit(*reinterpret_cast<const CharT(*)[N]>(text.data()));
+    const std::vector<CharT> cipher = ref::encrypt(text.data(), N, Seed);
+    const bool ascii = std::all_of(text.begin(), text.end(), [](CharT c) { return static_cast<unsigned long>(c) < 0x80; });
+
+    // encrypt_in_place() must produce the reference ciphertext, and the
+    // in-place decrypt must undo it.
+    std::vector<CharT> buf(text);
+    lit.encrypt_in_place(buf.data());
+    v.check(buf == cipher, "encrypt_in_place", type, N, Seed);
+    v.check(lit.decrypt_in_place(buf.data()) && buf == text, "decrypt_in_place", type, N, Seed);
+
+#if defined(SECURE_STRING_INTEGRITY)
+    // A flipped ciphertext bit must be caught and leave nothing behind.
+    buf = cipher;
+    buf[v.rng() % N] ^= static_cast<CharT>(1u << (v.rng() % 8));
+    const bool caught = !lit.decrypt_in_place(buf.data());
+    v.check(caught && std::all_of(buf.begin(), buf.end(), [](CharT c) { return c == 0; }), "tamper check", type, N, Seed);
+#endif
+
+    // decrypt() into every valid alignment up to 8 bytes, with guard bytes
+    // around the output.
+    std::vector<unsigned char> raw(N * sizeof(CharT) + 24, 0xCC);
+    for (std::size_t off = 0; off < 8; off += alignof(CharT)) {
+        std::fill(raw.begin(), raw.end(), 0xCC);
+        CharT* out = reinterpret_cast<CharT*>(raw.data() + 8 + off);
+        lit.decrypt(out);
+        const bool same = std::memcmp(out, text.data(), N * sizeof(CharT)) == 0;
+        const bool guarded = raw[7 + off] == 0xCC && raw[8 + off + N * sizeof(CharT)] == 0xCC;
+        v.check(same && guarded, "decrypt", type, N, Seed);
+    }
+
+    std::basic_string<CharT> s(1, CharT('x'));
+    v.check(lit.append_to(s) && s.size() == N && std::equal(text.begin(), text.end() - 1, s.begin() + 1), "append_to", type, N, Seed);
+
+    std::vector<CharT> joined;
+    const bool chunked = lit.write_chunks([&](const CharT* p, secure_u64 count) {
+        joined.insert(joined.end(), p, p + count);
+        return count <= SECURE_STRING_STAGING;
+    });
+    v.check(chunked && std::equal(text.begin(), text.end() - 1, joined.begin(), joined.end()), "write_chunks", type, N, Seed);
+
+    if constexpr (sizeof(CharT) == 1) {
+        if (ascii) {
+            std::vector<char16_t> u16(N + 1, 0xFFFF);
+            const secure_u64 len = lit.decrypt_as_utf16(u16.data(), N);
+            bool same = len == N - 1 && u16[N - 1] == 0;
+            for (std::size_t i = 0; same && i + 1 < N; ++i)
+                same = u16[i] == static_cast<char16_t>(text[i]);
+            v.check(same, "decrypt_as_utf16", type, N, Seed);
+        }
+    } else {
+        std::vector<char> expect;
+        for (std::size_t i = 0; i + 1 < N; ++i)
+            ref::put_utf8(expect, static_cast<unsigned long>(text[i]));
+        std::vector<char> u8(N * 4 + 1, '\x7F');
+        const secure_u64 len = lit.decrypt_as_utf8(u8.data(), N * 4 + 1);
+        v.check(len == expect.size() && u8[len] == 0 && std::equal(expect.begin(), expect.end(), u8.begin()),
+                "decrypt_as_utf8", type, N, Seed);
+    }
+}
+
+// ---- Case table -------------------------------------------------------------
+
+constexpr std::size_t kVerifyShortLengths = 34;
+constexpr std::size_t kVerifyLongLengths[] = {
+    63, 64, 65, 127, 128, 129, SECURE_STRING_STAGING - 1, SECURE_STRING_STAGING, SECURE_STRING_STAGING + 1,
+    SECURE_STRING_STAGING + 2, 2 * SECURE_STRING_STAGING + 1, 1000, 4099,
+};
+constexpr std::size_t kVerifyLengths = kVerifyShortLengths + sizeof(kVerifyLongLengths) / sizeof(kVerifyLongLengths[0]);
+constexpr std::size_t kVerifyCases = 64;
+
+constexpr std::size_t verify_length(std::size_t k) {
+    k %= kVerifyLengths;
+    return k < kVerifyShortLengths ? k + 1 : kVerifyLongLengths[k - kVerifyShortLengths];
+}
+
+constexpr unsigned long long verify_seed(std::size_t k) {
+    return k == 0 ? 0 : k == 1 ? ~0ULL : ref::mix(0x5EC0DE5EED5EC0DEULL + k);
+}
+
+template<typename CharT>
+struct VerifyCase {
+    std::size_t n;
+    unsigned long long seed;
+    void (*run)(Verify&, const CharT*);
+};
+
+template<typename CharT, std::size_t... K>
+constexpr std::array<VerifyCase<CharT>, sizeof...(K)> verify_table(std::index_sequence<K...>) {
+    return { { { verify_length(K), verify_seed(K), &verify_case<CharT, verify_length(K), verify_seed(K)> }... } };
+}
+
+template<typename CharT>
+inline constexpr std::array<VerifyCase<CharT>, kVerifyCases> kVerifyTable = verify_table<CharT>(std::make_index_sequence<kVerifyCases>());
+
+// Runs case c of the table on random text (ASCII only if ascii is set).
+template<typename CharT>
+void verify_random(Verify& v, const VerifyCase<CharT>& c, bool ascii) {
+    std::vector<CharT> text(c.n);
+    for (std::size_t i = 0; i + 1 < c.n; ++i)
+        text[i] = verify_char<CharT>(v.rng(), ascii);
+    text[c.n - 1] = 0;
+    c.run(v, text.data());
+}
@@ -0,0 +1,214 @@
+// Build-time statistics for encrypted literals
+// Author: oxunem (https://github.com/oxunem)
+// License: MIT
+//
+// Reads the manifest records that secure_string.hpp emits when built with
+// SECURE_STRING_MANIFEST and prints how many literals a build contains, how
+// many ciphertext bytes they take, how they are spread over source files
+// and which literals are the largest. A site is attributed to the file it
+// is written in (__FILE__), so sites in headers count for the header, not
+// for each translation unit that includes it.
+//
+// Usage:
+//    secure_manifest [--csv] [--top N] <binary or object>...
+//
+// Understands ELF (32/64-bit, objects and linked images) and linked PE
+// images. Records are identified by their magic, so section padding and
+// merged duplicates from several inputs are handled.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Mirrors SecureManifestEntry in secure_string.hpp.
+constexpr std::uint32_t kMagic = 0x464D5353;
+constexpr std::size_t kEntrySize = 128;
+constexpr std::size_t kFileOffset = 24;
+constexpr std::size_t kFileSize = 104;
+
+struct Entry {
+    std::string file;
+    std::uint32_t line;
+    std::uint32_t width;
+    std::uint32_t count;
+    std::uint64_t bytes;
+};
+
+template<typename T>
+T load(const std::vector<unsigned char>& d, std::size_t off) {
+    T v{};
+    if (off + sizeof(T) <= d.size())
+        std::memcpy(&v, d.data() + off, sizeof(T));
+    return v;
+}
+
+struct Range {
+    std::size_t offset;
+    std::size_t size;
+};
+
+// Offsets of all sections with the given name in an ELF file.
+std::vector<Range> elf_sections(const std::vector<unsigned char>& d, const char* name) {
+    std::vector<Range> out;
+    const bool is64 = d[4] == 2;
+    const std::uint64_t shoff = is64 ? load<std::uint64_t>(d, 0x28) : load<std::uint32_t>(d, 0x20);
+    const std::uint16_t shentsize = load<std::uint16_t>(d, is64 ? 0x3A : 0x2E);
+    const std::uint16_t shnum = load<std::uint16_t>(d, is64 ? 0x3C : 0x30);
+    const std::uint16_t shstrndx = load<std::uint16_t>(d, is64 ? 0x3E : 0x32);
+    if (!shoff || shstrndx >= shnum)
+        return out;
+
+    auto header = [&](std::size_t i, std::uint64_t& off, std::uint64_t& size, std::uint32_t& nm, std::uint32_t& type) {
+        const std::size_t h = shoff + i * shentsize;
+        nm = load<std::uint32_t>(d, h);
+        type = load<std::uint32_t>(d, h + 4);
+        off = is64 ? load<std::uint64_t>(d, h + 0x18) : load<std::uint32_t>(d, h + 0x10);
+        size = is64 ? load<std::uint64_t>(d, h + 0x20) : load<std::uint32_t>(d, h + 0x14);
+    };
+
+    std::uint64_t stroff, strsize;
+    std::uint32_t nm, type;
+    header(shstrndx, stroff, strsize, nm, type);
+
+    for (std::size_t i = 0; i < shnum; ++i) {
+        std::uint64_t off, size;
+        header(i, off, size, nm, type);
+        if (type == 8 /* SHT_NOBITS */ || stroff + nm >= d.size())
+            continue;
+        const char* s = reinterpret_cast<const char*>(d.data() + stroff + nm);
+        if (std::strncmp(s, name, d.size() - (stroff + nm)) == 0 && off + size <= d.size())
+            out.push_back({ static_cast<std::size_t>(off), static_cast<std::size_t>(size) });
+    }
+    return out;
+}
+
+// Offsets of all sections with the given (at most 8 character) name in a PE image.
+std::vector<Range> pe_sections(const std::vector<unsigned char>& d, const char* name) {
+    std::vector<Range> out;
+    const std::uint32_t pe = load<std::uint32_t>(d, 0x3C);
+    if (pe + 24 > d.size() || std::memcmp(d.data() + pe, "PE\0\0", 4) != 0)
+        return out;
+    const std::uint16_t sections = load<std::uint16_t>(d, pe + 6);
+    const std::uint16_t optional = load<std::uint16_t>(d, pe + 20);
+    const std::size_t table = pe + 24 + optional;
+
+    for (std::size_t i = 0; i < sections; ++i) {
+        const std::size_t h = table + i * 40;
+        if (h + 40 > d.size())
+            break;
+        char sname[9] = {};
+        std::memcpy(sname, d.data() + h, 8);
+        const std::uint32_t vsize = load<std::uint32_t>(d, h + 8);
+        const std::uint32_t rawsize = load<std::uint32_t>(d, h + 16);
+        const std::uint32_t raw = load<std::uint32_t>(d, h + 20);
+        const std::size_t size = std::min(vsize, rawsize);
+        if (std::strcmp(sname, name) == 0 && raw + size <= d.size())
+            out.push_back({ raw, size });
+    }
+    return out;
+}
+
+bool read_entries(const char* path, std::vector<Entry>& out) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        std::fprintf(stderr, "secure_manifest: cannot open %s\n", path);
+        return false;
+    }
+    std::vector<unsigned char> d((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    std::vector<Range> ranges;
+    if (d.size() > 0x40 && std::memcmp(d.data(), "\x7F" "ELF", 4) == 0)
+        ranges = elf_sections(d, "secure_manifest");
+    else if (d.size() > 0x40 && d[0] == 'M' && d[1] == 'Z')
+        ranges = pe_sections(d, "securemf");
+    else {
+        std::fprintf(stderr, "secure_manifest: %s is neither ELF nor PE\n", path);
+        return false;
+    }
+
+    for (const Range& r : ranges) {
+        for (std::size_t off = r.offset; off + kEntrySize <= r.offset + r.size;) {
+            if (load<std::uint32_t>(d, off) != kMagic) {
+                off += 8;
+                continue;
+            }
+            Entry e;
+            e.line = load<std::uint32_t>(d, off + 4);
+            e.width = load<std::uint32_t>(d, off + 8);
+            e.count = load<std::uint32_t>(d, off + 12);
+            e.bytes = load<std::uint64_t>(d, off + 16);
+            const char* f = reinterpret_cast<const char*>(d.data() + off + kFileOffset);
+            e.file.assign(f, strnlen(f, kFileSize));
+            out.push_back(e);
+            off += kEntrySize;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    bool csv = false;
+    std::size_t top = 10;
+    std::vector<const char*> inputs;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--csv") == 0)
+            csv = true;
+        else if (std::strcmp(argv[i], "--top") == 0 && i + 1 < argc)
+            top = static_cast<std::size_t>(std::strtoul(argv[++i], nullptr, 10));
+        else
+            inputs.push_back(argv[i]);
+    }
+    if (inputs.empty()) {
+        std::fprintf(stderr, "usage: secure_manifest [--csv] [--top N] <binary or object>...\n");
+        return 2;
+    }
+
+    std::vector<Entry> entries;
+    for (const char* path : inputs)
+        if (!read_entries(path, entries))
+            return 1;
+
+    if (csv) {
+        std::printf("file,line,width,count,bytes\n");
+        for (const Entry& e : entries)
+            std::printf("%s,%u,%u,%u,%llu\n", e.file.c_str(), e.line, e.width, e.count, static_cast<unsigned long long>(e.bytes));
+        return 0;
+    }
+
+    std::uint64_t total = 0;
+    std::map<std::string, std::pair<std::size_t, std::uint64_t>> files;
+    for (const Entry& e : entries) {
+        total += e.bytes;
+        auto& f = files[e.file];
+        ++f.first;
+        f.second += e.bytes;
+    }
+
+    std::printf("instantiations     %zu\n", entries.size());
+    std::printf("ciphertext bytes   %llu\n", static_cast<unsigned long long>(total));
+    std::printf("files              %zu\n\n", files.size());
+
+    std::vector<std::pair<std::string, std::pair<std::size_t, std::uint64_t>>> by_file(files.begin(), files.end());
+    std::sort(by_file.begin(), by_file.end(), [](const auto& a, const auto& b) { return a.second.second > b.second.second; });
+    std::printf("%8s %12s  %s\n", "literals", "bytes", "file");
+    for (const auto& f : by_file)
+        std::printf("%8zu %12llu  %s\n", f.second.first, static_cast<unsigned long long>(f.second.second), f.first.c_str());
+
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.bytes > b.bytes; });
+    std::printf("\nlargest literals\n%12s %8s %6s  %s\n", "bytes", "chars", "width", "site");
+    for (std::size_t i = 0; i < entries.size() && i < top; ++i)
+        std::printf("%12llu %8u %6u  %s:%u\n", static_cast<unsigned long long>(entries[i].bytes), entries[i].count,
+                    entries[i].width, entries[i].file.c_str(), entries[i].line);
+    return 0;
+}